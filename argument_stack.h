@@ -0,0 +1,62 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include "value.h"
+
+// Where the Interpreter evaluates the arguments of calls, which callees get
+// as a span. The values live in segments that never grow past the capacity
+// they were made with, so a span stays valid while the callee pushes the
+// arguments of calls of its own above it. The segments are kept, so calls
+// allocate nothing once the stack is as deep as it gets.
+class Argument_Stack {
+        static constexpr std::size_t segment_size { 4096 };
+
+        std::vector<std::vector<Value>> segments_;
+        std::size_t current_ = 0;
+
+    public:
+        // The arguments of one call, popped when it goes. Arguments of nested
+        // calls are pushed above and popped before this one pushes more.
+        class Frame {
+                Argument_Stack &stack_;
+                std::size_t segment_;
+                std::size_t base_;
+
+            public:
+                // room for count values in one segment
+                Frame(Argument_Stack &stack, std::size_t count): stack_ { stack } {
+                    auto &segments { stack_.segments_ };
+                    if (segments.empty()) { segments.emplace_back().reserve(std::max(count, segment_size)); }
+                    auto *segment { &segments[stack_.current_] };
+                    if (segment->capacity() - segment->size() < count) {
+                        if (++stack_.current_ == segments.size()) { segments.emplace_back(); }
+                        segment = &segments[stack_.current_];
+                        if (segment->capacity() < count) { segment->reserve(std::max(count, segment_size)); }
+                    }
+                    segment_ = stack_.current_;
+                    base_ = segment->size();
+                }
+
+                Frame(const Frame &) = delete;
+                Frame &operator=(const Frame &) = delete;
+
+                ~Frame() {
+                    auto &segments { stack_.segments_ };
+                    for (; stack_.current_ > segment_; --stack_.current_) { segments[stack_.current_].clear(); }
+                    segments[segment_].resize(base_);
+                }
+
+                void push(Value value) { stack_.segments_[segment_].push_back(std::move(value)); }
+
+                [[nodiscard]] std::size_t size() const { return stack_.segments_[segment_].size() - base_; }
+
+                [[nodiscard]] std::span<const Value> values() const {
+                    return { stack_.segments_[segment_].data() + base_, size() };
+                }
+        };
+};
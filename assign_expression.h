@@ -1,17 +1,29 @@
 #pragma once
 
 #include "expression.h"
-#include "token.h"
+#include "identifier.h"
 
 #include <memory>
 #include <utility>
 
 class Assign_Expression: public Expression {
 public:
-    const Token name;
+    const Identifier name;
     const Expression::Ptr value;
 
-    Assign_Expression(const Token &n, Expression::Ptr v): name { n }, value { std::move(v) } { }
+    // filled in by the Resolver: environment hops and slot, depth < 0 for globals
+    mutable int depth = -1;
+    mutable int slot = -1;
+    // the slot holds the Cell of a variable closures capture
+    mutable bool boxed = false;
+    // index into the closure's cells for a variable of an enclosing
+    // function, with depth < 0
+    mutable int upvalue = -1;
+
+    // slot in the Interpreter's global table, looked up on the first write
+    mutable int global = -1;
+
+    Assign_Expression(const Identifier &n, Expression::Ptr v): name { n }, value { std::move(v) } { }
 
     void accept(Expression_Visitor &visitor) const override { visitor.visit(*this); }
 };
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Bump allocator for the nodes of one parse. Nodes are laid out in parse
+// order in a few large blocks instead of one heap allocation each. The arena
+// counts its live allocations and frees all blocks once the last node and
+// the parser that created it are gone.
+class Ast_Arena {
+        std::vector<std::unique_ptr<std::byte[]>> blocks_;
+        std::byte *next_ = nullptr;
+        std::size_t left_ = 0;
+        std::size_t size_ = 0;
+        std::size_t users_ = 1;
+
+        Ast_Arena() = default;
+
+    public:
+        static constexpr std::size_t block_size { 64 * 1024 };
+
+        static Ast_Arena *create() { return new Ast_Arena { }; }
+
+        Ast_Arena(const Ast_Arena &) = delete;
+        Ast_Arena &operator=(const Ast_Arena &) = delete;
+
+        // bytes handed out so far
+        [[nodiscard]] std::size_t size() const { return size_; }
+
+        void retain() { ++users_; }
+        void release() { if (--users_ == 0) { delete this; } }
+
+        void *allocate(std::size_t size, std::size_t align) {
+            std::size_t padding { (align - reinterpret_cast<std::uintptr_t>(next_) % align) % align };
+            if (! next_ || padding + size > left_) {
+                std::size_t length { size + align > block_size ? size + align : block_size };
+                blocks_.emplace_back(new std::byte[length]);
+                next_ = blocks_.back().get();
+                left_ = length;
+                padding = (align - reinterpret_cast<std::uintptr_t>(next_) % align) % align;
+            }
+            std::byte *result { next_ + padding };
+            next_ = result + size;
+            left_ -= padding + size;
+            size_ += padding + size;
+            return result;
+        }
+};
+
+template<typename T> class Arena_Allocator {
+        template<typename U> friend class Arena_Allocator;
+
+        Ast_Arena *arena_;
+
+    public:
+        using value_type = T;
+
+        explicit Arena_Allocator(Ast_Arena *arena): arena_ { arena } { }
+        template<typename U> Arena_Allocator(const Arena_Allocator<U> &other): arena_ { other.arena_ } { }
+
+        T *allocate(std::size_t n) {
+            arena_->retain();
+            return static_cast<T *>(arena_->allocate(n * sizeof(T), alignof(T)));
+        }
+
+        void deallocate(T *, std::size_t) { arena_->release(); }
+
+        template<typename U> bool operator==(const Arena_Allocator<U> &other) const { return arena_ == other.arena_; }
+};
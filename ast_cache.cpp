@@ -0,0 +1,586 @@
+#include "ast_cache.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+
+#include "assign_expression.h"
+#include "ast_arena.h"
+#include "binary_expression.h"
+#include "block_statement.h"
+#include "call_expression.h"
+#include "class_statement.h"
+#include "expression.h"
+#include "expression_statement.h"
+#include "function_definition.h"
+#include "get_expression.h"
+#include "grouping.h"
+#include "if_statement.h"
+#include "literal.h"
+#include "logical_expression.h"
+#include "print_statement.h"
+#include "return_statement.h"
+#include "set_expression.h"
+#include "super_expression.h"
+#include "symbol.h"
+#include "this_expression.h"
+#include "token.h"
+#include "unary.h"
+#include "var_expression.h"
+#include "var_statement.h"
+#include "while_statement.h"
+
+#if defined(__unix__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// The file is a header, the table of names and strings, each as its length
+// and its bytes, and the statements. A node is its tag and its fields in
+// order; a null node is just NONE. Numbers are stored in host order, which
+// is fine for a file that only the machine that wrote it reads back.
+
+namespace {
+
+constexpr char magic[4] { 'L', 'O', 'X', 'C' };
+
+struct Header {
+    char magic[4];
+    std::uint32_t version;
+    std::uint64_t hash;
+    std::uint64_t size;
+    std::uint32_t strings;
+    std::uint32_t statements;
+    // the hash of the rest of the file, which catches one damaged since
+    std::uint64_t contents;
+};
+
+enum class Tag: std::uint8_t {
+    NONE,
+    BINARY, GROUPING, BOOL, NUMBER, STRING, UNARY, VAR, ASSIGN, LOGICAL, CALL, GET, SET, THIS, SUPER,
+    PRINT, EXPRESSION, VAR_STATEMENT, BLOCK, IF, WHILE, FUNCTION, RETURN, CLASS
+};
+
+// hashes eight bytes at a time, so that checking a large source costs
+// little next to loading its program
+std::uint64_t hash(std::string_view text) {
+    std::uint64_t result { 0x9e3779b97f4a7c15ull ^ text.size() };
+    auto mix { [&result](std::uint64_t word) {
+        result = (result ^ word) * 0xff51afd7ed558ccdull;
+        result ^= result >> 32;
+    } };
+    std::size_t i { 0 };
+    for (; i + 8 <= text.size(); i += 8) {
+        std::uint64_t word;
+        std::memcpy(&word, text.data() + i, 8);
+        mix(word);
+    }
+    std::uint64_t tail { 0 };
+    std::memcpy(&tail, text.data() + i, text.size() - i);
+    mix(tail);
+    return result;
+}
+
+class Writer: public Expression_Visitor, public Statement_Visitor {
+        std::string nodes_;
+        std::vector<std::string_view> strings_;
+        std::unordered_map<Symbol, std::uint32_t> indices_;
+
+        template<typename T> void write(T value) {
+            static_assert(std::is_trivially_copyable_v<T>);
+            nodes_.append(reinterpret_cast<const char *>(&value), sizeof(T));
+        }
+
+        void write(Tag tag) { write(static_cast<std::uint8_t>(tag)); }
+
+        void write(const Node_Token &token) {
+            write(static_cast<std::uint8_t>(token.type));
+            write(static_cast<std::uint32_t>(token.line));
+        }
+
+        void write_symbol(Symbol symbol) {
+            auto [got, added] { indices_.emplace(symbol, static_cast<std::uint32_t>(strings_.size())) };
+            if (added) { strings_.push_back(Symbol_Table::instance().name(symbol)); }
+            write(got->second);
+        }
+
+        void write(const Identifier &identifier) {
+            write_symbol(identifier.symbol);
+            write(static_cast<std::uint32_t>(identifier.line));
+        }
+
+        void write(const Expression::Ptr &expression) {
+            if (expression) { expression->accept(*this); } else { write(Tag::NONE); }
+        }
+
+        void write(const Statement::Ptr &statement) {
+            if (statement) { statement->accept(*this); } else { write(Tag::NONE); }
+        }
+
+        void write(const std::vector<Statement::Ptr> &statements) {
+            write(static_cast<std::uint32_t>(statements.size()));
+            for (const auto &statement : statements) { write(statement); }
+        }
+
+    public:
+        void write(std::ostream &out, std::uint64_t hash, std::uint64_t size, const std::vector<Statement::Ptr> &statements) {
+            for (const auto &statement : statements) { write(statement); }
+            std::string contents;
+            for (std::string_view text : strings_) {
+                auto length { static_cast<std::uint32_t>(text.size()) };
+                contents.append(reinterpret_cast<const char *>(&length), sizeof(length));
+                contents.append(text);
+            }
+            contents.append(nodes_);
+            Header header {
+                { }, Ast_Cache::version, hash, size,
+                static_cast<std::uint32_t>(strings_.size()), static_cast<std::uint32_t>(statements.size()),
+                ::hash(contents)
+            };
+            std::memcpy(header.magic, magic, sizeof(magic));
+            out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+            out.write(contents.data(), static_cast<std::streamsize>(contents.size()));
+        }
+
+        void visit(const Binary_Expression &expression) override {
+            write(Tag::BINARY);
+            write(expression.token);
+            write(expression.left);
+            write(expression.right);
+        }
+
+        void visit(const Grouping &grouping) override {
+            write(Tag::GROUPING);
+            write(grouping.expression);
+        }
+
+        void visit(const Literal &literal) override {
+            if (literal.is_bool()) {
+                write(Tag::BOOL);
+                write(static_cast<std::uint8_t>(literal.as_bool()));
+            } else if (literal.is_number()) {
+                write(Tag::NUMBER);
+                write(literal.as_number());
+            } else {
+                write(Tag::STRING);
+                write_symbol(Symbol_Table::instance().intern(literal.as_string()));
+            }
+        }
+
+        void visit(const Unary &unary) override {
+            write(Tag::UNARY);
+            write(unary.token);
+            write(unary.right);
+        }
+
+        void visit(const Var_Expression &expression) override {
+            write(Tag::VAR);
+            write(expression.name);
+        }
+
+        void visit(const Assign_Expression &expression) override {
+            write(Tag::ASSIGN);
+            write(expression.name);
+            write(expression.value);
+        }
+
+        void visit(const Logical_Expression &expression) override {
+            write(Tag::LOGICAL);
+            write(expression.token);
+            write(expression.left);
+            write(expression.right);
+        }
+
+        void visit(const Call_Expression &expression) override {
+            write(Tag::CALL);
+            write(expression.callee);
+            write(expression.paren);
+            write(static_cast<std::uint32_t>(expression.arguments.size()));
+            for (const auto &argument : expression.arguments) { write(argument); }
+        }
+
+        void visit(const Get_Expression &expression) override {
+            write(Tag::GET);
+            write(expression.object);
+            write(expression.name);
+        }
+
+        void visit(const Set_Expression &expression) override {
+            write(Tag::SET);
+            write(expression.object);
+            write(expression.name);
+            write(expression.value);
+        }
+
+        void visit(const This_Expression &expression) override {
+            write(Tag::THIS);
+            write(static_cast<std::uint32_t>(expression.name.line));
+        }
+
+        void visit(const Super_Expression &expression) override {
+            write(Tag::SUPER);
+            write(static_cast<std::uint32_t>(expression.keyword.line));
+            write(expression.method);
+        }
+
+        void visit(const Print_Statement &statement) override {
+            write(Tag::PRINT);
+            write(statement.expression);
+        }
+
+        void visit(const Expression_Statement &statement) override {
+            write(Tag::EXPRESSION);
+            write(statement.expression);
+        }
+
+        void visit(const Var_Statement &statement) override {
+            write(Tag::VAR_STATEMENT);
+            write(statement.name);
+            write(statement.initializer);
+        }
+
+        void visit(const Block_Statement &statement) override {
+            write(Tag::BLOCK);
+            write(statement.statements);
+        }
+
+        void visit(const If_Statement &statement) override {
+            write(Tag::IF);
+            write(statement.condition);
+            write(statement.then_branch);
+            write(statement.else_branch);
+        }
+
+        void visit(const While_Statement &statement) override {
+            write(Tag::WHILE);
+            write(statement.condition);
+            write(statement.body);
+        }
+
+        void visit(const Function_Definition &statement) override {
+            write(Tag::FUNCTION);
+            write(statement.name);
+            write(static_cast<std::uint8_t>(statement.kind));
+            write(static_cast<std::uint32_t>(statement.params.size()));
+            for (const auto &param : statement.params) { write(param); }
+            write(Statement::Ptr { statement.body });
+        }
+
+        void visit(const Return_Statement &statement) override {
+            write(Tag::RETURN);
+            write(statement.keyword);
+            write(statement.value);
+        }
+
+        void visit(const Class_Statement &statement) override {
+            write(Tag::CLASS);
+            write(statement.name);
+            write(static_cast<std::uint8_t>(statement.superclass != nullptr));
+            if (statement.superclass) { write(statement.superclass->name); }
+            write(static_cast<std::uint32_t>(statement.methods.size()));
+            for (const auto &method : statement.methods) { write(Statement::Ptr { method }); }
+        }
+};
+
+// Builds the nodes back from the mapped file. Anything out of place, like a
+// file cut short, throws, and the caller parses the source instead.
+class Reader {
+        class Exception: public std::domain_error {
+            public:
+                Exception(): std::domain_error { "bad cache" } { }
+        };
+
+        const std::byte *at_;
+        const std::byte *end_;
+        std::vector<Symbol> symbols_;
+        // string constants, made the first time a literal uses them
+        std::vector<Value> strings_;
+        Ast_Arena *arena_ { Ast_Arena::create() };
+        std::size_t nodes_ = 0;
+        std::size_t literals_ = 0;
+
+        template<typename T, typename... Args> std::shared_ptr<T> make(Args &&... args) {
+            ++nodes_;
+            if constexpr (std::is_base_of_v<Literal, T>) { ++literals_; }
+            return std::allocate_shared<T>(Arena_Allocator<T> { arena_ }, std::forward<Args>(args)...);
+        }
+
+        void need(std::size_t bytes) const {
+            if (static_cast<std::size_t>(end_ - at_) < bytes) { throw Exception { }; }
+        }
+
+        template<typename T> T read() {
+            need(sizeof(T));
+            T value;
+            std::memcpy(&value, at_, sizeof(T));
+            at_ += sizeof(T);
+            return value;
+        }
+
+        Tag tag() {
+            auto value { read<std::uint8_t>() };
+            if (value > static_cast<std::uint8_t>(Tag::CLASS)) { throw Exception { }; }
+            return static_cast<Tag>(value);
+        }
+
+        int line() { return static_cast<int>(read<std::uint32_t>()); }
+
+        std::uint32_t index() {
+            auto value { read<std::uint32_t>() };
+            if (value >= symbols_.size()) { throw Exception { }; }
+            return value;
+        }
+
+        // only the token types the parser keeps in nodes are taken
+        Node_Token node_token() {
+            auto type { read<std::uint8_t>() };
+            if (type >= static_cast<std::uint8_t>(Token_Type::END_OF_DATA)) { throw Exception { }; }
+            return Token { static_cast<Token_Type>(type), 0, 0, line() };
+        }
+
+        Identifier identifier() {
+            Symbol symbol { symbols_[index()] };
+            return Identifier { symbol, line() };
+        }
+
+        Value string() {
+            std::uint32_t at { index() };
+            if (strings_[at].is_nil()) {
+                strings_[at] = Symbol_Table::instance().string_constant(Symbol_Table::instance().name(symbols_[at]));
+            }
+            return strings_[at];
+        }
+
+        std::vector<Expression::Ptr> expressions() {
+            auto count { read<std::uint32_t>() };
+            std::vector<Expression::Ptr> result;
+            result.reserve(std::min<std::size_t>(count, end_ - at_));
+            for (std::uint32_t i { 0 }; i < count; ++i) { result.push_back(expression()); }
+            return result;
+        }
+
+        Block_Statement::Ptr block() {
+            auto count { read<std::uint32_t>() };
+            std::vector<Statement::Ptr> statements;
+            statements.reserve(std::min<std::size_t>(count, end_ - at_));
+            for (std::uint32_t i { 0 }; i < count; ++i) { statements.push_back(statement()); }
+            return make<Block_Statement>(std::move(statements));
+        }
+
+        Function_Definition::Ptr function() {
+            Identifier name { identifier() };
+            auto kind { read<std::uint8_t>() };
+            if (kind > static_cast<std::uint8_t>(Function_Kind::INITIALIZER)) { throw Exception { }; }
+            auto count { read<std::uint32_t>() };
+            std::vector<Identifier> params;
+            params.reserve(std::min<std::size_t>(count, end_ - at_));
+            for (std::uint32_t i { 0 }; i < count; ++i) { params.push_back(identifier()); }
+            Block_Statement::Ptr body;
+            if (Tag body_tag { tag() }; body_tag == Tag::BLOCK) {
+                body = block();
+            } else if (body_tag != Tag::NONE) {
+                throw Exception { };
+            }
+            return make<Function_Definition>(name, std::move(params), std::move(body), static_cast<Function_Kind>(kind));
+        }
+
+        Expression::Ptr expression() {
+            switch (tag()) {
+                case Tag::NONE: return { };
+                case Tag::BINARY: {
+                    Node_Token token { node_token() };
+                    Expression::Ptr left { expression() };
+                    return make<Binary_Expression>(token, std::move(left), expression());
+                }
+                case Tag::GROUPING: return make<Grouping>(expression());
+                case Tag::BOOL: return make<Bool_Literal>(read<std::uint8_t>() != 0);
+                case Tag::NUMBER: return make<Number_Literal>(read<double>());
+                case Tag::STRING: return make<String_Literal>(string());
+                case Tag::UNARY: {
+                    Node_Token token { node_token() };
+                    return make<Unary>(token, expression());
+                }
+                case Tag::VAR: return make<Var_Expression>(identifier());
+                case Tag::ASSIGN: {
+                    Identifier name { identifier() };
+                    return make<Assign_Expression>(name, expression());
+                }
+                case Tag::LOGICAL: {
+                    Node_Token token { node_token() };
+                    Expression::Ptr left { expression() };
+                    return make<Logical_Expression>(token, std::move(left), expression());
+                }
+                case Tag::CALL: {
+                    Expression::Ptr callee { expression() };
+                    Node_Token paren { node_token() };
+                    return make<Call_Expression>(std::move(callee), paren, expressions());
+                }
+                case Tag::GET: {
+                    Expression::Ptr object { expression() };
+                    return make<Get_Expression>(std::move(object), identifier());
+                }
+                case Tag::SET: {
+                    Expression::Ptr object { expression() };
+                    Identifier name { identifier() };
+                    return make<Set_Expression>(std::move(object), name, expression());
+                }
+                case Tag::THIS: return make<This_Expression>(Token { Token_Type::THIS, 0, 0, line() });
+                case Tag::SUPER: {
+                    Token keyword { Token_Type::SUPER, 0, 0, line() };
+                    return make<Super_Expression>(keyword, identifier());
+                }
+                default: throw Exception { };
+            }
+        }
+
+        Statement::Ptr statement() {
+            switch (tag()) {
+                case Tag::NONE: return { };
+                case Tag::PRINT: return make<Print_Statement>(expression());
+                case Tag::EXPRESSION: return make<Expression_Statement>(expression());
+                case Tag::VAR_STATEMENT: {
+                    Identifier name { identifier() };
+                    return make<Var_Statement>(name, expression());
+                }
+                case Tag::BLOCK: return block();
+                case Tag::IF: {
+                    Expression::Ptr condition { expression() };
+                    Statement::Ptr then_branch { statement() };
+                    return make<If_Statement>(std::move(condition), std::move(then_branch), statement());
+                }
+                case Tag::WHILE: {
+                    Expression::Ptr condition { expression() };
+                    return make<While_Statement>(std::move(condition), statement());
+                }
+                case Tag::FUNCTION: return function();
+                case Tag::RETURN: {
+                    Node_Token keyword { node_token() };
+                    return make<Return_Statement>(keyword, expression());
+                }
+                case Tag::CLASS: {
+                    Identifier name { identifier() };
+                    std::shared_ptr<const Var_Expression> superclass;
+                    if (read<std::uint8_t>()) { superclass = make<Var_Expression>(identifier()); }
+                    auto count { read<std::uint32_t>() };
+                    std::vector<Function_Definition::Ptr> methods;
+                    for (std::uint32_t i { 0 }; i < count; ++i) {
+                        if (tag() != Tag::FUNCTION) { throw Exception { }; }
+                        methods.push_back(function());
+                    }
+                    return make<Class_Statement>(name, std::move(superclass), std::move(methods));
+                }
+                default: throw Exception { };
+            }
+        }
+
+    public:
+        Reader(const std::byte *begin, const std::byte *end): at_ { begin }, end_ { end } { }
+        Reader(const Reader &) = delete;
+        Reader &operator=(const Reader &) = delete;
+        ~Reader() { arena_->release(); }
+
+        [[nodiscard]] std::size_t nodes() const { return nodes_; }
+        [[nodiscard]] std::size_t literals() const { return literals_; }
+
+        std::optional<std::vector<Statement::Ptr>> read(std::uint64_t hash, std::uint64_t size) {
+            try {
+                auto header { read<Header>() };
+                if (std::memcmp(header.magic, magic, sizeof(magic)) != 0 || header.version != Ast_Cache::version ||
+                    header.hash != hash || header.size != size ||
+                    header.contents != ::hash({ reinterpret_cast<const char *>(at_), static_cast<std::size_t>(end_ - at_) })
+                ) {
+                    return std::nullopt;
+                }
+                symbols_.reserve(std::min<std::size_t>(header.strings, end_ - at_));
+                for (std::uint32_t i { 0 }; i < header.strings; ++i) {
+                    auto length { read<std::uint32_t>() };
+                    need(length);
+                    symbols_.push_back(Symbol_Table::instance().intern({ reinterpret_cast<const char *>(at_), length }));
+                    at_ += length;
+                }
+                strings_.resize(symbols_.size());
+                std::vector<Statement::Ptr> statements;
+                statements.reserve(std::min<std::size_t>(header.statements, end_ - at_));
+                for (std::uint32_t i { 0 }; i < header.statements; ++i) { statements.push_back(statement()); }
+                if (at_ != end_) { return std::nullopt; }
+                return statements;
+            } catch (const Exception &) {
+                return std::nullopt;
+            }
+        }
+};
+
+}
+
+Ast_Cache::Ast_Cache(const std::string &script, std::string_view source):
+    path_ { script.ends_with(".lox") ? script + "c" : script + ".loxc" },
+    hash_ { hash(source) },
+    size_ { source.size() }
+{ }
+
+std::optional<std::vector<Statement::Ptr>> Ast_Cache::load() {
+#if defined(__unix__)
+    int fd { ::open(path_.c_str(), O_RDONLY) };
+    if (fd < 0) { return std::nullopt; }
+    struct stat status;
+    void *data { MAP_FAILED };
+    if (::fstat(fd, &status) == 0 && status.st_size > 0) {
+        data = ::mmap(nullptr, static_cast<std::size_t>(status.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    ::close(fd);
+    if (data == MAP_FAILED) { return std::nullopt; }
+    const auto *begin { static_cast<const std::byte *>(data) };
+    Reader reader { begin, begin + status.st_size };
+    auto statements { reader.read(hash_, size_) };
+    ::munmap(data, static_cast<std::size_t>(status.st_size));
+#else
+    std::ifstream in { path_, std::ios::binary };
+    if (! in) { return std::nullopt; }
+    std::string contents { std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>() };
+    const auto *begin { reinterpret_cast<const std::byte *>(contents.data()) };
+    Reader reader { begin, begin + contents.size() };
+    auto statements { reader.read(hash_, size_) };
+#endif
+    nodes_ = reader.nodes();
+    literals_ = reader.literals();
+    return statements;
+}
+
+void Ast_Cache::store(const std::vector<Statement::Ptr> &statements) const {
+    // written aside and renamed over the old file, so that runs reading it
+    // meanwhile see the whole of one or the other
+    std::string temporary { path_ + ".tmp" };
+#if defined(__unix__)
+    temporary += std::to_string(::getpid());
+#endif
+    // --batch can store the cache of one script from two threads at once
+    temporary += "." + std::to_string(std::hash<std::thread::id> { }(std::this_thread::get_id()));
+    {
+        std::ofstream out { temporary, std::ios::binary | std::ios::trunc };
+        if (! out) { return; }
+        Writer writer;
+        writer.write(out, hash_, size_, statements);
+        if (! out) {
+            out.close();
+            std::error_code ignored;
+            std::filesystem::remove(temporary, ignored);
+            return;
+        }
+    }
+    std::error_code error;
+    std::filesystem::rename(temporary, path_, error);
+    if (error) { std::filesystem::remove(temporary, error); }
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "statement.h"
+
+// A parsed program kept in a binary file next to its script, so that later
+// runs of the same source skip scanning, parsing and optimizing. It holds the
+// hash and size of the source it was parsed from and the format version;
+// it is only used while all three match. Names and string constants are
+// stored once each and interned when the file is loaded, straight from the
+// mapped file; nodes refer to them by index. The file has the program as
+// the Optimizer leaves it; the Resolver runs on it as usual.
+class Ast_Cache {
+        std::string path_;
+        std::uint64_t hash_;
+        std::uint64_t size_;
+        std::size_t nodes_ = 0;
+        std::size_t literals_ = 0;
+
+    public:
+        // bump whenever the nodes, the parser, the Optimizer or the file
+        // layout change
+        static constexpr std::uint32_t version { 1 };
+
+        // the cache of a script: script.lox keeps it in script.loxc
+        Ast_Cache(const std::string &script, std::string_view source);
+
+        [[nodiscard]] const std::string &path() const { return path_; }
+
+        // The program, if the file is there and matches the source;
+        // otherwise the caller parses the source.
+        std::optional<std::vector<Statement::Ptr>> load();
+
+        // Replaces the file with one for statements. A cache that cannot be
+        // written is left out silently; the script runs all the same.
+        void store(const std::vector<Statement::Ptr> &statements) const;
+
+        // nodes load made, for --stats
+        [[nodiscard]] std::size_t nodes() const { return nodes_; }
+        [[nodiscard]] std::size_t literals() const { return literals_; }
+};
@@ -0,0 +1,209 @@
+#pragma once
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "assign_expression.h"
+#include "binary_expression.h"
+#include "block_statement.h"
+#include "call_expression.h"
+#include "class_statement.h"
+#include "expression.h"
+#include "expression_statement.h"
+#include "function_definition.h"
+#include "get_expression.h"
+#include "grouping.h"
+#include "if_statement.h"
+#include "literal.h"
+#include "logical_expression.h"
+#include "print_statement.h"
+#include "return_statement.h"
+#include "set_expression.h"
+#include "statement.h"
+#include "super_expression.h"
+#include "this_expression.h"
+#include "token.h"
+#include "unary.h"
+#include "var_expression.h"
+#include "var_statement.h"
+#include "while_statement.h"
+
+// Writes a program as text for --dump-ast: one statement per line, nested
+// statements indented below their parent, expressions in prefix notation.
+class Ast_Printer: public Expression_Visitor, public Statement_Visitor {
+        std::ostream &out_;
+        int depth_ = 0;
+
+        void print(const Expression::Ptr &expression) {
+            if (expression) { expression->accept(*this); } else { out_ << "nil"; }
+        }
+
+        void print(const Statement::Ptr &statement) {
+            if (statement) { statement->accept(*this); }
+        }
+
+        void line(const std::string &text) { out_ << std::string(2 * depth_, ' ') << text; }
+
+        void nested(const Statement::Ptr &statement) {
+            ++depth_;
+            print(statement);
+            --depth_;
+        }
+
+        void nested(const std::vector<Statement::Ptr> &statements) {
+            ++depth_;
+            print(statements);
+            --depth_;
+        }
+
+        void prefix(const std::string &name, const Expression::Ptr &left, const Expression::Ptr &right) {
+            out_ << "(" << name << " ";
+            print(left);
+            out_ << " ";
+            print(right);
+            out_ << ")";
+        }
+
+    public:
+        explicit Ast_Printer(std::ostream &out): out_ { out } { }
+
+        void print(const std::vector<Statement::Ptr> &statements) {
+            for (const auto &statement : statements) { print(statement); }
+        }
+
+        void visit(const Binary_Expression &binary) override {
+            prefix(to_string(binary.token.type), binary.left, binary.right);
+        }
+
+        void visit(const Grouping &grouping) override {
+            out_ << "(group ";
+            print(grouping.expression);
+            out_ << ")";
+        }
+
+        void visit(const Literal &literal) override {
+            if (literal.is_string()) {
+                out_ << "\"" << literal.as_string() << "\"";
+            } else {
+                out_ << static_cast<std::string>(literal);
+            }
+        }
+
+        void visit(const Unary &unary) override {
+            out_ << "(" << to_string(unary.token.type) << " ";
+            print(unary.right);
+            out_ << ")";
+        }
+
+        void visit(const Var_Expression &expression) override { out_ << expression.name.lexeme(); }
+
+        void visit(const Assign_Expression &expression) override {
+            out_ << "(= " << expression.name.lexeme() << " ";
+            print(expression.value);
+            out_ << ")";
+        }
+
+        void visit(const Logical_Expression &expression) override {
+            prefix(to_string(expression.token.type), expression.left, expression.right);
+        }
+
+        void visit(const Call_Expression &expression) override {
+            out_ << "(call ";
+            print(expression.callee);
+            for (const auto &argument : expression.arguments) {
+                out_ << " ";
+                print(argument);
+            }
+            out_ << ")";
+        }
+
+        void visit(const Print_Statement &statement) override {
+            line("print ");
+            print(statement.expression);
+            out_ << "\n";
+        }
+
+        void visit(const Expression_Statement &statement) override {
+            line("");
+            print(statement.expression);
+            out_ << "\n";
+        }
+
+        void visit(const Var_Statement &statement) override {
+            line("var " + statement.name.lexeme());
+            if (statement.initializer) {
+                out_ << " = ";
+                print(statement.initializer);
+            }
+            out_ << "\n";
+        }
+
+        void visit(const Block_Statement &statement) override {
+            line("block\n");
+            nested(statement.statements);
+        }
+
+        void visit(const If_Statement &statement) override {
+            line("if ");
+            print(statement.condition);
+            out_ << "\n";
+            nested(statement.then_branch);
+            if (statement.else_branch) {
+                line("else\n");
+                nested(statement.else_branch);
+            }
+        }
+
+        void visit(const While_Statement &statement) override {
+            line("while ");
+            print(statement.condition);
+            out_ << "\n";
+            nested(statement.body);
+        }
+
+        void visit(const Function_Definition &statement) override {
+            line("fun " + statement.name.lexeme() + "(");
+            for (std::size_t i = 0; i < statement.params.size(); ++i) {
+                out_ << (i ? ", " : "") << statement.params[i].lexeme();
+            }
+            out_ << ")\n";
+            if (statement.body) { nested(statement.body->statements); }
+        }
+
+        void visit(const Return_Statement &statement) override {
+            line("return");
+            if (statement.value) {
+                out_ << " ";
+                print(statement.value);
+            }
+            out_ << "\n";
+        }
+
+        void visit(const Get_Expression &expression) override {
+            out_ << "(. ";
+            print(expression.object);
+            out_ << " " << expression.name.lexeme() << ")";
+        }
+
+        void visit(const Set_Expression &expression) override {
+            out_ << "(.= ";
+            print(expression.object);
+            out_ << " " << expression.name.lexeme() << " ";
+            print(expression.value);
+            out_ << ")";
+        }
+
+        void visit(const This_Expression &expression) override { out_ << "this"; }
+
+        void visit(const Super_Expression &expression) override { out_ << "(super " << expression.method.lexeme() << ")"; }
+
+        void visit(const Class_Statement &statement) override {
+            line("class " + statement.name.lexeme());
+            if (statement.superclass) { out_ << " < " << statement.superclass->name.lexeme(); }
+            out_ << "\n";
+            ++depth_;
+            for (const auto &method : statement.methods) { print(method); }
+            --depth_;
+        }
+};
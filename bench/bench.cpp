@@ -0,0 +1,293 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <streambuf>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "err.h"
+#include "interpreter.h"
+#include "optimizer.h"
+#include "parser.h"
+#include "resolver.h"
+#include "scanner.h"
+
+// Times the phases of running each workload in a directory of .lox files,
+// plus one large generated source: scanning all tokens, parsing the tokens
+// scanned beforehand, as --stats does, and interpreting the parsed and
+// resolved program. Each phase runs a few times untimed to warm up, then
+// repeatedly; a sample runs the phase as often as it takes to fill the
+// minimum time and counts the time per run, so that short phases are timed
+// as precisely as long ones. The results go to stdout and optionally to a
+// JSON file. With a baseline JSON file, phases slower than the threshold,
+// and by more than the floor, are reported as regressions and the exit
+// status is 1.
+//   lox_bench [--warmup=n] [--repeat=n] [--min-time=ms] [--json=file] [--baseline=file]
+//       [--threshold=percent] [--floor=ms] [dir]
+
+namespace {
+
+struct Workload {
+    std::string name;
+    std::string source;
+};
+
+struct Result {
+    std::string workload;
+    std::string phase;
+    int runs;
+    // times the phase ran in each of the runs
+    int iterations;
+    double min_ms;
+    double median_ms;
+    double mean_ms;
+};
+
+// swallows what the workloads print
+class Null_Buffer: public std::streambuf {
+    protected:
+        int overflow(int ch) override { return ch; }
+};
+
+// many small functions and the calls between them, to give the scanner and
+// the parser a large input
+std::string generated_source(int functions) {
+    std::ostringstream out;
+    for (int i = 0; i < functions; ++i) {
+        out << "// function " << i << " of the generated source\n";
+        out << "fun f" << i << "(a, b) {\n";
+        out << "    var x = a * " << i << " + b / 2;\n";
+        out << "    if (x > " << i << " and b != nil) { x = x - 1; } else { x = x + 1; }\n";
+        out << "    var s = \"f" << i << "\" + \"!\";\n";
+        out << "    return x;\n";
+        out << "}\n";
+    }
+    out << "var total = 0;\n";
+    for (int i = 0; i < functions; ++i) { out << "total = total + f" << i << "(" << i << ", 3);\n"; }
+    out << "print total;\n";
+    return out.str();
+}
+
+std::vector<Workload> load(const std::filesystem::path &directory) {
+    std::vector<Workload> workloads;
+    for (const auto &entry : std::filesystem::directory_iterator { directory }) {
+        if (entry.path().extension() != ".lox") { continue; }
+        std::ifstream in(entry.path());
+        workloads.push_back({
+            entry.path().stem().string(),
+            std::string { std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>() }
+        });
+    }
+    std::sort(workloads.begin(), workloads.end(), [](const auto &a, const auto &b) { return a.name < b.name; });
+    workloads.push_back({ "generated", generated_source(5000) });
+    return workloads;
+}
+
+void scan(const std::string &source, Reporter &reporter) {
+    Scanner scanner { source, reporter };
+    for (std::size_t index = 0; scanner.token(index).type != Token_Type::END_OF_DATA; ++index) {
+        if (index % 4096 == 0) { scanner.release(index); }
+    }
+}
+
+// Returns the time parsing took; the tokens are all scanned before, so
+// the scan phase is not counted twice.
+std::chrono::steady_clock::duration parse(const std::string &source, Reporter &reporter) {
+    Scanner scanner { source, reporter };
+    for (std::size_t index { 0 }; scanner.token(index).type != Token_Type::END_OF_DATA; ++index) { }
+    Parser parser { scanner };
+    auto start { std::chrono::steady_clock::now() };
+    parser.parse();
+    return std::chrono::steady_clock::now() - start;
+}
+
+// Returns the time interpreting took; parsing and resolving a fresh copy
+// of the program are not counted, as the interpreter caches lookups on the
+// tree.
+std::chrono::steady_clock::duration interpret(const std::string &source, Reporter &reporter, std::ostream &out) {
+    Scanner scanner { source, reporter };
+    Parser parser { scanner };
+    auto parsed { parser.parse() };
+    Optimizer optimizer { parser.arena() };
+    auto statements { optimizer.optimize(parsed) };
+    Resolver resolver { reporter };
+    resolver.resolve(statements);
+    Interpreter interpreter { reporter, out };
+    auto start { std::chrono::steady_clock::now() };
+    interpreter.interpret(statements);
+    return std::chrono::steady_clock::now() - start;
+}
+
+Result measure(
+    const std::string &workload, const std::string &phase, int warmup, int repeat, double min_ms,
+    const std::function<std::chrono::steady_clock::duration()> &run
+) {
+    for (int i = 0; i < warmup; ++i) { run(); }
+    // the first run tells how many make up the minimum time
+    double once { std::chrono::duration<double, std::milli>(run()).count() };
+    int iterations { once >= min_ms ? 1 : static_cast<int>(min_ms / std::max(once, 1e-6)) + 1 };
+    std::vector<double> times;
+    for (int i = 0; i < repeat; ++i) {
+        std::chrono::steady_clock::duration sample { };
+        for (int j = 0; j < iterations; ++j) { sample += run(); }
+        times.push_back(std::chrono::duration<double, std::milli>(sample).count() / iterations);
+    }
+    std::sort(times.begin(), times.end());
+    double total { 0 };
+    for (double time : times) { total += time; }
+    return { workload, phase, repeat, iterations, times.front(), times[times.size() / 2], total / times.size() };
+}
+
+// times a phase that has nothing to leave out
+std::function<std::chrono::steady_clock::duration()> timed(std::function<void()> phase) {
+    return [phase { std::move(phase) }] {
+        auto start { std::chrono::steady_clock::now() };
+        phase();
+        return std::chrono::steady_clock::now() - start;
+    };
+}
+
+void write_json(std::ostream &out, const std::vector<Result> &results) {
+    out << "[\n";
+    for (std::size_t i = 0; i < results.size(); ++i) {
+        const auto &result { results[i] };
+        out << std::fixed << std::setprecision(4)
+            << "  {\"workload\": \"" << result.workload << "\", \"phase\": \"" << result.phase
+            << "\", \"runs\": " << result.runs << ", \"iterations\": " << result.iterations
+            << ", \"min_ms\": " << result.min_ms
+            << ", \"median_ms\": " << result.median_ms << ", \"mean_ms\": " << result.mean_ms << "}"
+            << (i + 1 < results.size() ? ",\n" : "\n");
+    }
+    out << "]\n";
+}
+
+// the value of a key in one line of the JSON write_json writes
+std::string field(const std::string &line, const std::string &key) {
+    std::string quoted { "\"" + key + "\": " };
+    auto start { line.find(quoted) };
+    if (start == std::string::npos) { return { }; }
+    start += quoted.size();
+    if (line[start] == '"') {
+        ++start;
+        return line.substr(start, line.find('"', start) - start);
+    }
+    return line.substr(start, line.find_first_of(",}", start) - start);
+}
+
+// min_ms by workload and phase
+std::map<std::pair<std::string, std::string>, double> read_json(std::istream &in) {
+    std::map<std::pair<std::string, std::string>, double> times;
+    std::string line;
+    while (std::getline(in, line)) {
+        std::string workload { field(line, "workload") };
+        if (workload.empty()) { continue; }
+        times[{ workload, field(line, "phase") }] = std::strtod(field(line, "min_ms").c_str(), nullptr);
+    }
+    return times;
+}
+
+// Compares the best times, which vary the least between runs. Returns
+// whether any phase got slower by more than threshold percent and by more
+// than floor_ms, below which the noise of timing a phase outweighs it.
+bool compare(const std::vector<Result> &results, std::istream &baseline, double threshold, double floor_ms) {
+    auto before { read_json(baseline) };
+    bool regressed { false };
+    for (const auto &result : results) {
+        auto got { before.find({ result.workload, result.phase }) };
+        if (got == before.end() || got->second <= 0) { continue; }
+        double change { (result.min_ms / got->second - 1) * 100 };
+        bool slower { change > threshold && result.min_ms - got->second > floor_ms };
+        regressed = regressed || slower;
+        std::cout << (slower ? "REGRESSION " : "           ") << std::left << std::setw(24)
+            << result.workload + "/" + result.phase << std::right << std::fixed << std::setprecision(3)
+            << std::setw(12) << got->second << " ms -> " << std::setw(10) << result.min_ms << " ms ("
+            << std::showpos << std::setprecision(1) << change << std::noshowpos << "%)\n";
+    }
+    return regressed;
+}
+
+void usage(const char *name) {
+    std::cerr << "Usage: " << name
+        << " [--warmup=n] [--repeat=n] [--min-time=ms] [--json=file] [--baseline=file] [--threshold=percent]"
+        << " [--floor=ms] [dir]\n";
+    exit(EXIT_FAILURE);
+}
+
+}
+
+int main(int argc, const char *argv[]) {
+    int warmup { 2 };
+    int repeat { 10 };
+    double min_ms { 10 };
+    double threshold { 5 };
+    double floor_ms { 0.005 };
+    const char *json { nullptr };
+    const char *baseline { nullptr };
+    std::filesystem::path directory { "bench" };
+    for (int i = 1; i < argc; ++i) {
+        if (std::strncmp(argv[i], "--warmup=", 9) == 0) {
+            warmup = std::atoi(argv[i] + 9);
+        } else if (std::strncmp(argv[i], "--repeat=", 9) == 0) {
+            repeat = std::max(1, std::atoi(argv[i] + 9));
+        } else if (std::strncmp(argv[i], "--min-time=", 11) == 0) {
+            min_ms = std::strtod(argv[i] + 11, nullptr);
+        } else if (std::strncmp(argv[i], "--json=", 7) == 0) {
+            json = argv[i] + 7;
+        } else if (std::strncmp(argv[i], "--baseline=", 11) == 0) {
+            baseline = argv[i] + 11;
+        } else if (std::strncmp(argv[i], "--threshold=", 12) == 0) {
+            threshold = std::strtod(argv[i] + 12, nullptr);
+        } else if (std::strncmp(argv[i], "--floor=", 8) == 0) {
+            floor_ms = std::strtod(argv[i] + 8, nullptr);
+        } else if (argv[i][0] == '-') {
+            usage(argv[0]);
+        } else {
+            directory = argv[i];
+        }
+    }
+
+    std::vector<Result> results;
+    Null_Buffer null;
+    std::ostream out { &null };
+    for (const auto &workload : load(directory)) {
+        const std::string &source { workload.source };
+        Reporter reporter { std::cerr };
+        results.push_back(measure(workload.name, "scan", warmup, repeat, min_ms, timed([&] { scan(source, reporter); })));
+        results.push_back(measure(workload.name, "parse", warmup, repeat, min_ms, [&] { return parse(source, reporter); }));
+        results.push_back(measure(
+            workload.name, "interpret", warmup, repeat, min_ms, [&] { return interpret(source, reporter, out); }
+        ));
+        if (reporter.had_error || reporter.had_runtime_error) {
+            std::cerr << workload.name << " failed\n";
+            return EXIT_FAILURE;
+        }
+        for (auto i { results.end() - 3 }; i != results.end(); ++i) {
+            std::cout << std::left << std::setw(24) << i->workload + "/" + i->phase << std::right << std::fixed
+                << std::setprecision(3) << std::setw(12) << i->min_ms << " ms min" << std::setw(12) << i->median_ms
+                << " ms median\n";
+        }
+    }
+
+    if (json) {
+        std::ofstream out { json };
+        write_json(out, results);
+    }
+    if (baseline) {
+        std::ifstream in { baseline };
+        if (! in) {
+            std::cerr << "Could not read " << baseline << ".\n";
+            return EXIT_FAILURE;
+        }
+        if (compare(results, in, threshold, floor_ms)) { return EXIT_FAILURE; }
+    }
+    return EXIT_SUCCESS;
+}
@@ -2,17 +2,34 @@
 
 #include "expression.h"
 
+#include <cstdint>
 #include <memory>
 
 #include "token.h"
 
 class Binary_Expression: public Expression {
     public:
-        const Token token;
+        enum class Specialization: std::uint8_t {
+            UNSEEN, GENERIC,
+            NUMBER_ADD, NUMBER_SUBTRACT, NUMBER_MULTIPLY, NUMBER_DIVIDE,
+            NUMBER_GREATER, NUMBER_GREATER_EQUAL, NUMBER_LESS, NUMBER_LESS_EQUAL,
+            STRING_CONCAT
+        };
+
+        // operands the Interpreter can read without visiting them
+        enum class Operand: std::uint8_t { NODE, LOCAL, NUMBER };
+
+        const Node_Token token;
         const Expression::Ptr left;
         const Expression::Ptr right;
 
-        Binary_Expression(const Token& t, Expression::Ptr l, Expression::Ptr r):
+        // chosen by the Interpreter from the operands of the first
+        // evaluation; reset to GENERIC for good once its guard fails
+        mutable Specialization specialization = Specialization::UNSEEN;
+        mutable Operand left_operand = Operand::NODE;
+        mutable Operand right_operand = Operand::NODE;
+
+        Binary_Expression(const Node_Token &t, Expression::Ptr l, Expression::Ptr r):
             token { t }, left { std::move(l) }, right { std::move(r) }
         { }
 
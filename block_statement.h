@@ -11,6 +11,9 @@ public:
 
     const std::vector<Statement::Ptr> statements;
 
+    // number of variables declared directly in the block; blocks without any get no environment
+    mutable int frame_size = 0;
+
     explicit Block_Statement(std::vector<Statement::Ptr> s): statements { std::move(s) } { }
 
     void accept(Statement_Visitor &visitor) const override { visitor.visit(*this); }
@@ -2,19 +2,32 @@
 
 #include "expression.h"
 
+#include <cstdint>
 #include <memory>
 #include <vector>
 
+#include "get_expression.h"
 #include "token.h"
 
 class Call_Expression: public Expression {
 public:
     const Expression::Ptr callee;
-    const Token paren;
+    const Node_Token paren;
     const std::vector<Expression::Ptr> arguments;
 
-    Call_Expression(Expression::Ptr l, const Token &p, std::vector<Expression::Ptr> &&a):
-            callee { std::move(l) }, paren { p }, arguments { std::move(a) }
+    // the callee if it is a property: a method call runs the method on the
+    // instance without binding it first
+    const Get_Expression *const method;
+
+    // inline cache for callees read from a global: the slot and its version
+    // when the callee there was last checked to be callable with this many
+    // arguments; set by the Interpreter
+    mutable int global = -1;
+    mutable std::uint32_t version = 0;
+
+    Call_Expression(Expression::Ptr l, const Node_Token &p, std::vector<Expression::Ptr> &&a):
+            callee { std::move(l) }, paren { p }, arguments { std::move(a) },
+            method { dynamic_cast<const Get_Expression *>(callee.get()) }
     { }
 
     void accept(Expression_Visitor &visitor) const override { visitor.visit(*this); }
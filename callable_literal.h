@@ -1,14 +1,18 @@
 #pragma once
 
-#include <vector>
+#include <span>
+#include <string>
 
-#include "literal.h"
+#include "object.h"
+#include "value.h"
 
 class Interpreter;
 
-class Callable_Literal: public Literal {
+class Callable_Literal: public Object {
 public:
+    Callable_Literal(): Object { Object_Type::CALLABLE } { }
     explicit operator std::string() const override { return "<native fn>"; }
-    virtual Literal::Ptr call(Interpreter &interpreter, const std::vector<Literal::Ptr> &arguments) const = 0;
+    // the arguments are valid until the call returns
+    virtual Value call(Interpreter &interpreter, std::span<const Value> arguments) const = 0;
     virtual int arity() const = 0;
 };
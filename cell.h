@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <utility>
+
+#include "object.h"
+#include "value.h"
+
+// The box a variable captured by a nested function lives in. Its slot in
+// the declaring frame holds the cell instead of the value, and every
+// closure that captures the variable shares the cell, so writes on either
+// side are seen by the other. Variables no closure captures stay unboxed.
+class Cell: public Object {
+    public:
+        mutable Value value;
+
+        explicit Cell(Value v = { }): Object { Object_Type::CELL }, value { std::move(v) } { }
+
+        [[nodiscard]] std::size_t size() const override { return sizeof(Cell); }
+
+        void trace(Gc_Tracer &tracer) const override { value.trace(tracer); }
+
+        void clear() override { value = { }; }
+
+        explicit operator std::string() const override { return value.to_string(); }
+};
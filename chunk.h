@@ -0,0 +1,129 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "object.h"
+#include "shape.h"
+#include "symbol.h"
+#include "value.h"
+
+enum class Op_Code: std::uint8_t {
+    CONSTANT, NIL, TRUE, FALSE, POP, POP_N,
+    GET_LOCAL, SET_LOCAL, GET_GLOBAL, DEFINE_GLOBAL, SET_GLOBAL,
+    BOX, GET_CELL, SET_CELL, GET_UPVALUE, SET_UPVALUE, CLOSURE,
+    EQUAL, NOT_EQUAL, GREATER, GREATER_EQUAL, LESS, LESS_EQUAL,
+    ADD, SUBTRACT, MULTIPLY, DIVIDE, NOT, NEGATE,
+    PRINT, JUMP, JUMP_IF_FALSE, LOOP, CALL, TAIL_CALL, RETURN,
+    CLASS, GET_PROPERTY, SET_PROPERTY, INVOKE, GET_SUPER, SUPER_INVOKE,
+    TAIL_INVOKE, TAIL_SUPER_INVOKE,
+    // the high byte of the index the next op takes, for a chunk with more
+    // than 64k constants, names or globals
+    WIDE
+};
+
+class Chunk {
+    public:
+        // the largest index into the constants, names or globals an op can
+        // take, with WIDE before it
+        static constexpr int max_index { 0xffffff };
+
+        std::vector<std::uint8_t> code;
+        std::vector<int> lines;
+        std::vector<Value> constants;
+        // the names properties, methods and classes are looked up by, and
+        // for a property access site what it saw last
+        std::vector<Symbol> names;
+        mutable std::vector<Property_Cache> caches;
+
+        void write(std::uint8_t byte, int line) {
+            code.push_back(byte);
+            lines.push_back(line);
+        }
+
+        void write(Op_Code op, int line) { write(static_cast<std::uint8_t>(op), line); }
+
+        void write_short(int value, int line) {
+            write(static_cast<std::uint8_t>((value >> 8) & 0xff), line);
+            write(static_cast<std::uint8_t>(value & 0xff), line);
+        }
+
+        // an index of up to 24 bits
+        void write_long(int value, int line) {
+            write(static_cast<std::uint8_t>((value >> 16) & 0xff), line);
+            write_short(value & 0xffff, line);
+        }
+
+        int add_constant(Value value) {
+            constants.push_back(std::move(value));
+            return static_cast<int>(constants.size()) - 1;
+        }
+
+        int add_name(Symbol name) {
+            names.push_back(name);
+            caches.emplace_back();
+            return static_cast<int>(names.size()) - 1;
+        }
+};
+
+class Compiled_Function: public Object {
+    public:
+        const std::string name;
+        int arity = 0;
+        Chunk chunk;
+        // for --profile: Class.method for a method, and the line it is
+        // defined on
+        std::string label { name };
+        int line = 0;
+
+        explicit Compiled_Function(std::string n): Object { Object_Type::COMPILED_FUNCTION }, name { std::move(n) } { }
+
+        [[nodiscard]] std::size_t size() const override {
+            return sizeof(Compiled_Function) + chunk.code.capacity() + chunk.lines.capacity() * sizeof(int) +
+                chunk.constants.capacity() * sizeof(Value) + chunk.caches.capacity() * sizeof(Property_Cache);
+        }
+
+        void trace(Gc_Tracer &tracer) const override {
+            for (const auto &constant : chunk.constants) { constant.trace(tracer); }
+            for (const auto &cache : chunk.caches) { cache.trace(tracer); }
+        }
+
+        void clear() override {
+            chunk.constants.clear();
+            chunk.caches.clear();
+        }
+
+        explicit operator std::string() const override {
+            return name.empty() ? "<script>" : "<fn " + name + ">";
+        }
+};
+
+// A function together with the Cells of the variables it captures, made
+// by CLOSURE each time the definition runs. Functions that capture nothing
+// are called as plain Compiled_Functions.
+class Closure: public Object {
+    public:
+        Value function;
+        std::vector<Value> cells;
+
+        Closure(Value f, std::vector<Value> c):
+            Object { Object_Type::CLOSURE }, function { std::move(f) }, cells { std::move(c) }
+        { }
+
+        [[nodiscard]] std::size_t size() const override { return sizeof(Closure) + cells.capacity() * sizeof(Value); }
+
+        void trace(Gc_Tracer &tracer) const override {
+            function.trace(tracer);
+            for (const auto &cell : cells) { cell.trace(tracer); }
+        }
+
+        void clear() override {
+            function = { };
+            cells.clear();
+        }
+
+        explicit operator std::string() const override { return function.to_string(); }
+};
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "statement.h"
+
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "function_definition.h"
+#include "identifier.h"
+#include "var_expression.h"
+
+class Class_Statement: public Statement {
+public:
+    const Identifier name;
+    const std::shared_ptr<const Var_Expression> superclass;
+    const std::vector<Function_Definition::Ptr> methods;
+
+    // slot of the class name, < 0 for globals, and whether nested functions
+    // capture it or `super`; set by the Resolver
+    mutable int slot = -1;
+    mutable bool captured = false;
+    mutable bool super_captured = false;
+
+    Class_Statement(const Identifier &n, std::shared_ptr<const Var_Expression> s, std::vector<Function_Definition::Ptr> &&m):
+            name { n }, superclass { std::move(s) }, methods { std::move(m) } { }
+
+    void accept(Statement_Visitor &visitor) const override { visitor.visit(*this); }
+};
@@ -0,0 +1,466 @@
+#include "compiler.h"
+
+#include "assign_expression.h"
+#include "binary_expression.h"
+#include "block_statement.h"
+#include "call_expression.h"
+#include "class_statement.h"
+#include "err.h"
+#include "expression_statement.h"
+#include "function_definition.h"
+#include "get_expression.h"
+#include "grouping.h"
+#include "if_statement.h"
+#include "literal.h"
+#include "logical_expression.h"
+#include "print_statement.h"
+#include "return_statement.h"
+#include "set_expression.h"
+#include "super_expression.h"
+#include "this_expression.h"
+#include "unary.h"
+#include "var_expression.h"
+#include "var_statement.h"
+#include "while_statement.h"
+
+Compiler::Exception Compiler::error(const std::string &message) const {
+    reporter_.error(line_, message);
+    return {};
+}
+
+void Compiler::emit(Op_Code op, int operand) {
+    emit(op);
+    chunk().write(static_cast<std::uint8_t>(operand), line_);
+}
+
+void Compiler::emit_short(Op_Code op, int operand) {
+    emit(op);
+    chunk().write_short(operand, line_);
+}
+
+void Compiler::emit_index(Op_Code op, int index) {
+    if (index > 0xffff) { emit(Op_Code::WIDE, index >> 16); }
+    emit_short(op, index & 0xffff);
+}
+
+int Compiler::emit_jump(Op_Code op) {
+    emit_short(op, 0xffff);
+    return static_cast<int>(chunk().code.size()) - 2;
+}
+
+void Compiler::patch_jump(int offset) {
+    int jump { static_cast<int>(chunk().code.size()) - offset - 2 };
+    if (jump > 0xffff) { throw error("Too much code to jump over."); }
+    chunk().code[offset] = static_cast<std::uint8_t>((jump >> 8) & 0xff);
+    chunk().code[offset + 1] = static_cast<std::uint8_t>(jump & 0xff);
+}
+
+void Compiler::emit_loop(int start) {
+    emit(Op_Code::LOOP);
+    int offset { static_cast<int>(chunk().code.size()) - start + 2 };
+    if (offset > 0xffff) { throw error("Loop body too large."); }
+    chunk().write_short(offset, line_);
+}
+
+void Compiler::emit_constant(Value value) {
+    int index { chunk().add_constant(std::move(value)) };
+    if (index > Chunk::max_index) { throw error("Too many constants in one chunk."); }
+    emit_index(Op_Code::CONSTANT, index);
+}
+
+int Compiler::global_slot(Symbol name) {
+    int slot { globals_.slot(name) };
+    if (slot > Chunk::max_index) { throw error("Too many global variables."); }
+    return slot;
+}
+
+int Compiler::add_name(Symbol name) {
+    int index { chunk().add_name(name) };
+    if (index > Chunk::max_index) { throw error("Too many names in one chunk."); }
+    return index;
+}
+
+// the end of a function body; init returns the instance
+void Compiler::emit_return() {
+    if (current_->kind == Function_Kind::INITIALIZER) { compile_this(); } else { emit(Op_Code::NIL); }
+    emit(Op_Code::RETURN);
+}
+
+// the instance a method runs on, from slot 0 of its own frame
+void Compiler::compile_this() {
+    emit(current_->this_boxed ? Op_Code::GET_CELL : Op_Code::GET_LOCAL, 0);
+}
+
+void Compiler::end_scope() {
+    --current_->scope_depth;
+    int count { 0 };
+    while (! current_->locals.empty() && current_->locals.back().depth > current_->scope_depth) {
+        current_->locals.pop_back();
+        ++count;
+    }
+    if (count == 1) {
+        emit(Op_Code::POP);
+    } else if (count > 1) {
+        emit(Op_Code::POP_N, count);
+    }
+}
+
+int Compiler::resolve_local(Symbol name) const {
+    for (int i = static_cast<int>(current_->locals.size()) - 1; i >= 0; --i) {
+        if (current_->locals[i].name == name) { return i; }
+    }
+    return -1;
+}
+
+void Compiler::declare_variable(const Identifier &name) {
+    if (current_->scope_depth == 0) { return; }
+    for (auto i { current_->locals.rbegin() }; i != current_->locals.rend(); ++i) {
+        if (i->depth < current_->scope_depth) { break; }
+        if (i->name == name.symbol) { return; }
+    }
+    if (current_->locals.size() > 0xff) { throw error("Too many local variables in function."); }
+    current_->locals.push_back({ name.symbol, -1 });
+}
+
+void Compiler::define_variable(const Identifier &name, bool captured) {
+    line_ = name.line;
+    if (current_->scope_depth == 0) {
+        emit_index(Op_Code::DEFINE_GLOBAL, global_slot(name.symbol));
+        return;
+    }
+    auto &local { current_->locals.back() };
+    if (local.depth < 0) {
+        local.depth = current_->scope_depth;
+        // a variable closures capture lives in a Cell in its slot
+        if (captured) { emit(Op_Code::BOX, static_cast<int>(current_->locals.size()) - 1); }
+        return;
+    }
+    // redefinition in the same scope overwrites, just like Environment::define
+    emit(captured ? Op_Code::SET_CELL : Op_Code::SET_LOCAL, resolve_local(name.symbol));
+    emit(Op_Code::POP);
+}
+
+void Compiler::compile(const Expression::Ptr &expression) {
+    if (expression) { expression->accept(*this); } else { emit(Op_Code::NIL); }
+}
+
+void Compiler::compile(const Statement::Ptr &statement) {
+    if (statement) { statement->accept(*this); }
+}
+
+Value Compiler::compile(const std::vector<Statement::Ptr> &statements) {
+    Function_State script { "", Function_Kind::FUNCTION };
+    script.locals.push_back({ no_symbol, 0 });
+    current_ = &script;
+    try {
+        for (const auto &statement : statements) { compile(statement); }
+    } catch (const Exception &) {
+        current_ = nullptr;
+        return { };
+    }
+    emit_return();
+    current_ = nullptr;
+    return script.object;
+}
+
+void Compiler::compile_function(const Function_Definition &definition) {
+    Function_State state { definition.name.lexeme(), definition.kind };
+    state.function->arity = static_cast<int>(definition.params.size());
+    state.function->label = definition.label();
+    state.function->line = definition.name.line;
+    // slot 0 holds the function itself, or the instance a method runs on
+    // under the same slot the Resolver gave this
+    bool method { definition.is_method() };
+    state.locals.push_back({ method ? Symbol_Table::instance().intern("this") : no_symbol, 0 });
+    state.scope_depth = 1;
+
+    Function_State *enclosing { current_ };
+    int enclosing_line { line_ };
+    current_ = &state;
+    line_ = definition.name.line;
+    try {
+        for (const auto &param : definition.params) {
+            if (state.locals.size() > 0xff) { throw error("Too many local variables in function."); }
+            state.locals.push_back({ param.symbol, state.scope_depth });
+        }
+        for (int slot : definition.captured_params) {
+            emit(Op_Code::BOX, method ? slot : slot + 1);
+            if (method && slot == 0) { state.this_boxed = true; }
+        }
+        if (definition.body) {
+            for (const auto &statement : definition.body->statements) { compile(statement); }
+        }
+        emit_return();
+    } catch (...) {
+        current_ = enclosing;
+        throw;
+    }
+    current_ = enclosing;
+    line_ = enclosing_line;
+    if (definition.captures.empty()) {
+        emit_constant(state.object);
+        return;
+    }
+
+    // the Resolver found the variables; their Cells are in the enclosing
+    // function's locals or its own cells
+    if (definition.captures.size() > 0xff) { throw error("Too many captured variables in function."); }
+    int index { chunk().add_constant(state.object) };
+    if (index > Chunk::max_index) { throw error("Too many constants in one chunk."); }
+    emit_index(Op_Code::CLOSURE, index);
+    chunk().write(static_cast<std::uint8_t>(definition.captures.size()), line_);
+    for (const auto &capture : definition.captures) {
+        bool local { capture.depth >= 0 };
+        chunk().write(local ? 1 : 0, line_);
+        chunk().write(static_cast<std::uint8_t>(local ? resolve_local(capture.name) : capture.slot), line_);
+    }
+}
+
+void Compiler::visit(const Binary_Expression &binary) {
+    compile(binary.left);
+    compile(binary.right);
+    line_ = binary.token.line;
+    switch (binary.token.type) {
+        case Token_Type::GREATER: emit(Op_Code::GREATER); break;
+        case Token_Type::GREATER_EQUAL: emit(Op_Code::GREATER_EQUAL); break;
+        case Token_Type::LESS: emit(Op_Code::LESS); break;
+        case Token_Type::LESS_EQUAL: emit(Op_Code::LESS_EQUAL); break;
+        case Token_Type::BANG_EQUAL: emit(Op_Code::NOT_EQUAL); break;
+        case Token_Type::EQUAL_EQUAL: emit(Op_Code::EQUAL); break;
+        case Token_Type::MINUS: emit(Op_Code::SUBTRACT); break;
+        case Token_Type::PLUS: emit(Op_Code::ADD); break;
+        case Token_Type::SLASH: emit(Op_Code::DIVIDE); break;
+        case Token_Type::STAR: emit(Op_Code::MULTIPLY); break;
+        default: throw error("Unknown binary operator.");
+    }
+}
+
+void Compiler::visit(const Grouping &grouping) {
+    compile(grouping.expression);
+}
+
+void Compiler::visit(const Literal &literal) {
+    if (literal.is_bool()) {
+        emit(literal.as_bool() ? Op_Code::TRUE : Op_Code::FALSE);
+    } else {
+        emit_constant(literal.to_value());
+    }
+}
+
+void Compiler::visit(const Unary &unary) {
+    compile(unary.right);
+    line_ = unary.token.line;
+    switch (unary.token.type) {
+        case Token_Type::BANG: emit(Op_Code::NOT); break;
+        case Token_Type::MINUS: emit(Op_Code::NEGATE); break;
+        default: throw error("Unknown unary operator.");
+    }
+}
+
+void Compiler::visit(const Var_Expression &expression) {
+    line_ = expression.name.line;
+    int local { resolve_local(expression.name.symbol) };
+    if (local >= 0) {
+        emit(expression.boxed ? Op_Code::GET_CELL : Op_Code::GET_LOCAL, local);
+    } else if (expression.upvalue >= 0) {
+        emit(Op_Code::GET_UPVALUE, expression.upvalue);
+    } else {
+        emit_index(Op_Code::GET_GLOBAL, global_slot(expression.name.symbol));
+    }
+}
+
+void Compiler::visit(const Assign_Expression &expression) {
+    compile(expression.value);
+    line_ = expression.name.line;
+    int local { resolve_local(expression.name.symbol) };
+    if (local >= 0) {
+        emit(expression.boxed ? Op_Code::SET_CELL : Op_Code::SET_LOCAL, local);
+    } else if (expression.upvalue >= 0) {
+        emit(Op_Code::SET_UPVALUE, expression.upvalue);
+    } else {
+        emit_index(Op_Code::SET_GLOBAL, global_slot(expression.name.symbol));
+    }
+}
+
+void Compiler::visit(const Logical_Expression &expression) {
+    compile(expression.left);
+    line_ = expression.token.line;
+    if (expression.token.type == Token_Type::OR) {
+        int else_jump { emit_jump(Op_Code::JUMP_IF_FALSE) };
+        int end_jump { emit_jump(Op_Code::JUMP) };
+        patch_jump(else_jump);
+        emit(Op_Code::POP);
+        compile(expression.right);
+        patch_jump(end_jump);
+    } else {
+        int end_jump { emit_jump(Op_Code::JUMP_IF_FALSE) };
+        emit(Op_Code::POP);
+        compile(expression.right);
+        patch_jump(end_jump);
+    }
+}
+
+void Compiler::compile_call(const Call_Expression &expression, bool tail) {
+    int count { static_cast<int>(expression.arguments.size()) };
+    // a method is called on the instance in the callee's slot, without
+    // binding it first
+    if (expression.method) {
+        compile(expression.method->object);
+        for (const auto &argument : expression.arguments) { compile(argument); }
+        line_ = expression.paren.line;
+        emit_index(tail ? Op_Code::TAIL_INVOKE : Op_Code::INVOKE, add_name(expression.method->name.symbol));
+        chunk().write(static_cast<std::uint8_t>(count), line_);
+        return;
+    }
+    if (auto super { dynamic_cast<const Super_Expression *>(expression.callee.get()) }) {
+        visit(super->receiver);
+        for (const auto &argument : expression.arguments) { compile(argument); }
+        visit(super->superclass);
+        line_ = expression.paren.line;
+        emit_index(tail ? Op_Code::TAIL_SUPER_INVOKE : Op_Code::SUPER_INVOKE, add_name(super->method.symbol));
+        chunk().write(static_cast<std::uint8_t>(count), line_);
+        return;
+    }
+    compile(expression.callee);
+    for (const auto &argument : expression.arguments) { compile(argument); }
+    line_ = expression.paren.line;
+    emit(tail ? Op_Code::TAIL_CALL : Op_Code::CALL, count);
+}
+
+void Compiler::visit(const Call_Expression &expression) { compile_call(expression, false); }
+
+void Compiler::visit(const Get_Expression &expression) {
+    compile(expression.object);
+    line_ = expression.name.line;
+    emit_index(Op_Code::GET_PROPERTY, add_name(expression.name.symbol));
+}
+
+void Compiler::visit(const Set_Expression &expression) {
+    compile(expression.object);
+    compile(expression.value);
+    line_ = expression.name.line;
+    emit_index(Op_Code::SET_PROPERTY, add_name(expression.name.symbol));
+}
+
+void Compiler::visit(const This_Expression &expression) {
+    visit(static_cast<const Var_Expression &>(expression));
+}
+
+void Compiler::visit(const Super_Expression &expression) {
+    visit(expression.receiver);
+    visit(expression.superclass);
+    line_ = expression.method.line;
+    emit_index(Op_Code::GET_SUPER, add_name(expression.method.symbol));
+}
+
+void Compiler::visit(const Print_Statement &statement) {
+    compile(statement.expression);
+    emit(Op_Code::PRINT);
+}
+
+void Compiler::visit(const Expression_Statement &statement) {
+    if (! statement.expression) { return; }
+    compile(statement.expression);
+    emit(Op_Code::POP);
+}
+
+void Compiler::visit(const Var_Statement &statement) {
+    compile(statement.initializer);
+    declare_variable(statement.name);
+    define_variable(statement.name, statement.captured);
+}
+
+void Compiler::visit(const Block_Statement &statement) {
+    begin_scope();
+    for (const auto &s : statement.statements) { compile(s); }
+    end_scope();
+}
+
+void Compiler::visit(const If_Statement &statement) {
+    compile(statement.condition);
+    int then_jump { emit_jump(Op_Code::JUMP_IF_FALSE) };
+    emit(Op_Code::POP);
+    compile(statement.then_branch);
+    int else_jump { emit_jump(Op_Code::JUMP) };
+    patch_jump(then_jump);
+    emit(Op_Code::POP);
+    compile(statement.else_branch);
+    patch_jump(else_jump);
+}
+
+void Compiler::visit(const While_Statement &statement) {
+    int loop_start { static_cast<int>(chunk().code.size()) };
+    compile(statement.condition);
+    int exit_jump { emit_jump(Op_Code::JUMP_IF_FALSE) };
+    emit(Op_Code::POP);
+    compile(statement.body);
+    emit_loop(loop_start);
+    patch_jump(exit_jump);
+    emit(Op_Code::POP);
+}
+
+void Compiler::visit(const Function_Definition &statement) {
+    if (! statement.captured || current_->scope_depth == 0) {
+        compile_function(statement);
+        declare_variable(statement.name);
+        define_variable(statement.name, false);
+        return;
+    }
+    // a function that refers to itself captures its own cell, so that has
+    // to exist before the closure is made
+    emit(Op_Code::NIL);
+    declare_variable(statement.name);
+    define_variable(statement.name, true);
+    compile_function(statement);
+    emit(Op_Code::SET_CELL, resolve_local(statement.name.symbol));
+    emit(Op_Code::POP);
+}
+
+void Compiler::visit(const Return_Statement &statement) {
+    if (statement.tail_call) {
+        compile_call(*statement.tail_call, true);
+    } else if (! statement.value && current_->kind == Function_Kind::INITIALIZER) {
+        compile_this();
+    } else {
+        compile(statement.value);
+    }
+    line_ = statement.keyword.line;
+    emit(Op_Code::RETURN);
+}
+
+void Compiler::visit(const Class_Statement &statement) {
+    line_ = statement.name.line;
+    bool local { current_->scope_depth > 0 };
+    if (local) {
+        // methods that refer to the class capture its slot, so that has to
+        // exist before they are made
+        emit(Op_Code::NIL);
+        declare_variable(statement.name);
+        define_variable(statement.name, statement.captured);
+    }
+    if (statement.superclass) {
+        // the methods capture super from a scope of its own
+        Identifier super { Symbol_Table::instance().intern("super"), statement.superclass->name.line };
+        visit(*statement.superclass);
+        begin_scope();
+        declare_variable(super);
+        define_variable(super, statement.super_captured);
+        emit(statement.super_captured ? Op_Code::GET_CELL : Op_Code::GET_LOCAL, resolve_local(super.symbol));
+    }
+    if (statement.methods.size() > 0xff) { throw error("Too many methods in one class."); }
+    for (const auto &method : statement.methods) { compile_function(*method); }
+
+    line_ = statement.name.line;
+    emit_index(Op_Code::CLASS, add_name(statement.name.symbol));
+    chunk().write(statement.superclass ? 1 : 0, line_);
+    chunk().write(static_cast<std::uint8_t>(statement.methods.size()), line_);
+    for (const auto &method : statement.methods) { chunk().write_long(add_name(method->name.symbol), line_); }
+
+    if (local) {
+        emit(statement.captured ? Op_Code::SET_CELL : Op_Code::SET_LOCAL, resolve_local(statement.name.symbol));
+        emit(Op_Code::POP);
+    } else {
+        emit_index(Op_Code::DEFINE_GLOBAL, global_slot(statement.name.symbol));
+    }
+    if (statement.superclass) { end_scope(); }
+}
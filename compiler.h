@@ -0,0 +1,103 @@
+#pragma once
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "chunk.h"
+#include "err.h"
+#include "expression.h"
+#include "function_definition.h"
+#include "global_table.h"
+#include "statement.h"
+#include "identifier.h"
+#include "value.h"
+
+class Compiler: public Expression_Visitor, public Statement_Visitor {
+        class Exception: public std::domain_error {
+            public:
+                Exception(): std::domain_error { "compile exception" } { }
+        };
+
+        struct Local {
+            Symbol name;
+            int depth;
+        };
+
+        struct Function_State {
+            Function_State(const std::string &name, Function_Kind k):
+                function { new Compiled_Function(name) }, object { function }, kind { k }
+            { }
+
+            Compiled_Function *function;
+            Value object;
+            Function_Kind kind;
+            // whether this lives in a Cell, as closures in a method capture it
+            bool this_boxed = false;
+            std::vector<Local> locals;
+            int scope_depth = 0;
+        };
+
+        Global_Table &globals_;
+        Reporter &reporter_;
+        Function_State *current_ = nullptr;
+        int line_ = 0;
+
+        Chunk &chunk() { return current_->function->chunk; }
+        void emit(Op_Code op) { chunk().write(op, line_); }
+        void emit(Op_Code op, int operand);
+        void emit_short(Op_Code op, int operand);
+        // an op taking an index into the constants, names or globals, with
+        // WIDE before it where the index needs more than 16 bits
+        void emit_index(Op_Code op, int index);
+        int emit_jump(Op_Code op);
+        void patch_jump(int offset);
+        void emit_loop(int start);
+        void emit_constant(Value value);
+        void emit_return();
+        int add_name(Symbol name);
+        int global_slot(Symbol name);
+
+        void begin_scope() { ++current_->scope_depth; }
+        void end_scope();
+        int resolve_local(Symbol name) const;
+        void declare_variable(const Identifier &name);
+        void define_variable(const Identifier &name, bool captured);
+
+        void compile(const Expression::Ptr &expression);
+        void compile(const Statement::Ptr &statement);
+        void compile_function(const Function_Definition &definition);
+        void compile_this();
+        // a call, in place of the returning frame when tail is set
+        void compile_call(const Call_Expression &expression, bool tail);
+
+        [[nodiscard]] Exception error(const std::string &message) const;
+
+    public:
+        Compiler(Global_Table &globals, Reporter &reporter): globals_ { globals }, reporter_ { reporter } { }
+
+        Value compile(const std::vector<Statement::Ptr> &statements);
+
+        void visit(const Binary_Expression &binary) override;
+        void visit(const Grouping &grouping) override;
+        void visit(const Literal &literal) override;
+        void visit(const Unary &unary) override;
+        void visit(const Var_Expression &expression) override;
+        void visit(const Assign_Expression &expression) override;
+        void visit(const Logical_Expression &expression) override;
+        void visit(const Call_Expression &expression) override;
+        void visit(const Get_Expression &expression) override;
+        void visit(const Set_Expression &expression) override;
+        void visit(const This_Expression &expression) override;
+        void visit(const Super_Expression &expression) override;
+
+        void visit(const Print_Statement &statement) override;
+        void visit(const Expression_Statement &statement) override;
+        void visit(const Var_Statement &statement) override;
+        void visit(const Block_Statement &statement) override;
+        void visit(const If_Statement &statement) override;
+        void visit(const While_Statement &statement) override;
+        void visit(const Function_Definition &statement) override;
+        void visit(const Return_Statement &statement) override;
+        void visit(const Class_Statement &statement) override;
+};
@@ -1,50 +1,42 @@
 #pragma once
 
-#include <map>
-#include <string>
-#include <memory>
+#include <cstddef>
 #include <utility>
+#include <vector>
 
-#include "literal.h"
-#include "token.h"
+#include "gc.h"
+#include "pool.h"
+#include "value.h"
 
-class Environment {
+class Environment final: public Gc_Node {
     public:
-        using Ptr = std::shared_ptr<Environment>;
+        using Ptr = Ref<Environment>;
         Ptr enclosing_;
-        std::map<std::string, Literal::Ptr> values_;
+        std::vector<Value, Pool_Allocator<Value>> slots_;
     public:
-        class Exception : public std::runtime_error {
-            public:
-                const Token token;
-
-                Exception(const Token &t, const std::string &msg): std::runtime_error { msg }, token { t } { }
-        };
-
         Environment() = default;
         explicit Environment(Ptr enc): enclosing_ { std::move(enc) } { }
+        Environment(Ptr enc, int size): enclosing_ { std::move(enc) }, slots_(size) { }
 
         Ptr &enclosing() { return enclosing_; }
 
-        void define(const std::string &name, Literal::Ptr value) {
-            values_[name] = std::move(value);
+        [[nodiscard]] Value &at(int depth, int slot) {
+            Environment *env { this };
+            for (; depth > 0; --depth) { env = env->enclosing_.get(); }
+            return env->slots_[slot];
+        }
+
+        [[nodiscard]] std::size_t size() const override {
+            return sizeof(Environment) + slots_.capacity() * sizeof(Value);
         }
 
-        [[nodiscard]] const Literal::Ptr &get(const Token &name) const {
-            const auto &got { values_.find(name.lexeme) };
-            if (got != values_.end()) { return got->second; }
-            if (enclosing_) { return enclosing_->get(name); }
-            throw Exception { name, "Undefined variable '" + name.lexeme + "'." };
+        void trace(Gc_Tracer &tracer) const override {
+            if (enclosing_) { tracer(enclosing_.get()); }
+            for (const auto &value : slots_) { value.trace(tracer); }
         }
 
-        void assign(const Token &name, Literal::Ptr value) {
-            auto got { values_.find(name.lexeme) };
-            if (got != values_.end()) {
-                got->second = std::move(value);
-            } else if (enclosing_) {
-                enclosing_->assign(name, std::move(value));
-            } else {
-                throw Exception{name, "Undefined variable '" + name.lexeme + "'."};
-            }
+        void clear() override {
+            enclosing_ = nullptr;
+            for (auto &value : slots_) { value = Value { }; }
         }
-};
\ No newline at end of file
+};
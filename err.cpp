@@ -1,30 +1,25 @@
 #include "err.h"
 
-#include <iostream>
-
 #include "token.h"
 
-bool had_error = false;
-bool had_runtime_error = false;
-
-static void report(int line, const std::string& where, const std::string& message) {
-    std::cerr << "[line " << line << "] Error" << where << ": " << message << "\n";
+void Reporter::report(int line, const std::string &where, const std::string &message) {
+    out_ << "[line " << line << "] Error" << where << ": " << message << "\n";
     had_error = true;
 }
 
-void error(int line, const std::string& message) {
+void Reporter::error(int line, const std::string &message) {
     report(line, "", message);
 }
 
-void error(const Token &token, const std::string& message) {
+void Reporter::error(const Token &token, std::string_view lexeme, const std::string &message) {
     if (token.type == Token_Type::END_OF_DATA) {
         report(token.line, " at end", message);
     } else {
-        report(token.line, " at '" + token.lexeme + "'", message);
+        report(token.line, " at '" + std::string { lexeme } + "'", message);
     }
 }
 
-void runtime_error(const Token &token, const std::string &message) {
-    std::cerr << message << "\n[line " << token.line << "]\n";
+void Reporter::runtime_error(int line, const std::string &message) {
+    out_ << message << "\n[line " << line << "]\n";
     had_runtime_error = true;
-}
\ No newline at end of file
+}
@@ -1,13 +1,26 @@
 #pragma once
 
+#include <ostream>
 #include <string>
-
-void error(int line, const std::string& message);
+#include <string_view>
 
 class Token;
 
-void error(const Token &token, const std::string& message);
-void runtime_error(const Token &token, const std::string &message);
+// Where a run reports its syntax and runtime errors, and whether it had
+// any. Every run has one of its own, so runs on different threads keep
+// their errors apart.
+class Reporter {
+        std::ostream &out_;
+
+        void report(int line, const std::string &where, const std::string &message);
+
+    public:
+        bool had_error = false;
+        bool had_runtime_error = false;
+
+        explicit Reporter(std::ostream &out): out_ { out } { }
 
-extern bool had_error;
-extern bool had_runtime_error;
\ No newline at end of file
+        void error(int line, const std::string &message);
+        void error(const Token &token, std::string_view lexeme, const std::string &message);
+        void runtime_error(int line, const std::string &message);
+};
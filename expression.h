@@ -14,9 +14,13 @@ class Expression {
 class Assign_Expression;
 class Binary_Expression;
 class Call_Expression;
+class Get_Expression;
 class Grouping;
 class Literal;
 class Logical_Expression;
+class Set_Expression;
+class Super_Expression;
+class This_Expression;
 class Unary;
 class Var_Expression;
 
@@ -31,5 +35,9 @@ public:
     virtual void visit(const Assign_Expression &expr) = 0;
     virtual void visit(const Logical_Expression &expr) = 0;
     virtual void visit(const Call_Expression &expr) = 0;
+    virtual void visit(const Get_Expression &expr) = 0;
+    virtual void visit(const Set_Expression &expr) = 0;
+    virtual void visit(const This_Expression &expr) = 0;
+    virtual void visit(const Super_Expression &expr) = 0;
 };
 
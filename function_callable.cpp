@@ -1,16 +1,129 @@
 #include "function_callable.h"
 
+#include <algorithm>
+#include <unordered_set>
+
 #include "interpreter.h"
+#include "profiler.h"
+
+Value Function_Callable::call(Interpreter &interpreter, std::span<const Value> arguments) const {
+    auto &stats { interpreter.stats };
+    stats.peak_depth = std::max(stats.peak_depth, ++stats.depth);
+    Value result;
+    if (Profiler::enabled) {
+        Profiler::instance().enter(definition.get(), [this] {
+            return Profiler::Label { definition->label(), definition->name.line };
+        });
+        result = memoized(interpreter, arguments);
+        Profiler::instance().leave();
+    } else {
+        result = memoized(interpreter, arguments);
+    }
+    --stats.depth;
+    return result;
+}
+
+Value Function_Callable::memoized(Interpreter &interpreter, std::span<const Value> arguments) const {
+    if (! Memo_Table::enabled || ! pure(interpreter)) { return run(interpreter, arguments); }
+    if (! memo_stats_) { memo_stats_ = &interpreter.stats.memo[definition->name.lexeme()]; }
+    if (const Value *cached { memo_.find(arguments) }) {
+        ++memo_stats_->hits;
+        return *cached;
+    }
+    ++memo_stats_->misses;
+    Value result { run(interpreter, arguments) };
+    // a call that made an object has to make a new one next time, so only
+    // values and strings, which match by content, are kept
+    if (! interpreter.unwinding() && (! result.is_object() || result.is_string())) { memo_.insert(arguments, result); }
+    return result;
+}
+
+// Pure if the body is and so is every function it calls by name, as the
+// globals are bound now. The answer holds until one of the globals it
+// looked at is written.
+bool Function_Callable::pure(Interpreter &interpreter) const {
+    auto &globals { interpreter.globals };
+    if (checked_ && std::all_of(pure_as_of_.begin(), pure_as_of_.end(),
+        [&globals](const auto &seen) { return globals.versions[seen.first] == seen.second; })
+    ) {
+        return pure_;
+    }
+
+    memo_.clear();
+    pure_as_of_.clear();
+    checked_ = true;
+
+    std::vector<const Function_Definition *> pending { definition.get() };
+    std::unordered_set<const Function_Definition *> seen { definition.get() };
+    pure_ = true;
+    while (pure_ && ! pending.empty()) {
+        const Function_Definition *function { pending.back() };
+        pending.pop_back();
+        if (! function->pure) {
+            pure_ = false;
+            break;
+        }
+        for (Symbol name : function->callees) {
+            int slot { globals.slot(name) };
+            pure_as_of_.emplace_back(slot, globals.versions[slot]);
+            const Value &value { globals.values[slot] };
+            auto callee {
+                globals.defined[slot] && value.is_object(Object_Type::CALLABLE)
+                    ? dynamic_cast<const Function_Callable *>(&value.as<Callable_Literal>()) : nullptr
+            };
+            if (! callee) {
+                pure_ = false;
+                break;
+            }
+            if (seen.insert(callee->definition.get()).second) { pending.push_back(callee->definition.get()); }
+        }
+    }
+    return pure_;
+}
+
+Value Function_Callable::run(Interpreter &interpreter, std::span<const Value> arguments) const {
+    Value result { invoke(interpreter, arguments) };
+    // calls in tail position run here, in place of the frame that made
+    // them, so tail recursion needs no more stack than a loop
+    Value callee;
+    std::vector<Value> tail_arguments;
+    while (interpreter.take_tail_call(callee, tail_arguments)) {
+        const auto &function { callee.as<Function_Callable>() };
+        if (Profiler::enabled) {
+            // the call takes the place of the caller on the stack as well
+            Profiler::instance().leave();
+            Profiler::instance().enter(function.definition.get(), [&function] {
+                return Profiler::Label { function.definition->label(), function.definition->name.line };
+            });
+        }
+        result = function.invoke(interpreter, tail_arguments);
+    }
+    return result;
+}
 
-Literal::Ptr Function_Callable::call(Interpreter &interpreter, const std::vector<Literal::Ptr> &arguments) const {
-    Environment::Ptr env = std::make_shared<Environment>(interpreter.globals);
-    for (int i = 0; i < definition->params.size(); ++i) {
-        env->define(definition->params[i].lexeme, arguments[i]);
+Value Function_Callable::invoke(Interpreter &interpreter, std::span<const Value> arguments) const {
+    ++interpreter.stats.calls;
+    if (Jit::enabled && ! compiled_ && calls_++ >= Jit::threshold) {
+        compiled_ = true;
+        code_ = Jit::compile(*definition);
+        if (code_) { ++interpreter.stats.jit_compiled; }
     }
-    try {
-        interpreter.execute_block(*definition->body, env);
-    } catch (const Interpreter::Return &ret) {
-        return ret.value;
+    Value result;
+    if (code_ && ! code_->retired) {
+        result = code_->run(interpreter, arguments);
+    } else {
+        // a method gets the instance it runs on ahead of the parameters
+        ++interpreter.stats.environments;
+        Environment::Ptr env = make_ref<Environment>(nullptr, definition->frame_size);
+        for (int i = 0; i < arguments.size(); ++i) {
+            env->slots_[i] = arguments[i];
+        }
+        for (int slot : definition->captured_params) {
+            env->slots_[slot] = Value::make<Cell>(std::move(env->slots_[slot]));
+        }
+        interpreter.execute_body(definition->body->statements, env, cells_);
+        result = interpreter.finish_call();
     }
-    return {};
+    // init returns the instance however it returns
+    return definition->kind == Function_Kind::INITIALIZER ? arguments[0] : result;
 }
@@ -1,18 +1,70 @@
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <utility>
+#include <vector>
+
 #include "callable_literal.h"
 #include "function_definition.h"
 #include "environment.h"
+#include "jit.h"
+#include "memo_table.h"
 
 class Function_Callable: public Callable_Literal {
     Function_Definition::Ptr definition;
+    // the Cells of the variables it captures, in the order of
+    // definition->captures
+    std::vector<Value> cells_;
+
+    // calls so far, and the native code once the Jit compiled the function
+    mutable int calls_ = 0;
+    mutable bool compiled_ = false;
+    mutable std::unique_ptr<Jit_Code> code_;
+
+    // --memoize: earlier results, and the global slots and versions that
+    // made the function pure when that was last checked
+    mutable Memo_Table memo_;
+    mutable Memo_Table::Stats *memo_stats_ = nullptr;
+    mutable std::vector<std::pair<int, std::uint32_t>> pure_as_of_;
+    mutable bool checked_ = false;
+    mutable bool pure_ = false;
+
+    [[nodiscard]] bool pure(Interpreter &interpreter) const;
+
+    // the call, with the result from the memo table if it can be
+    Value memoized(Interpreter &interpreter, std::span<const Value> arguments) const;
+
+    // runs the body and the calls it makes in tail position
+    Value run(Interpreter &interpreter, std::span<const Value> arguments) const;
+
+    // runs the body once, leaving any tail call it ends with pending
+    Value invoke(Interpreter &interpreter, std::span<const Value> arguments) const;
 
 public:
-    explicit Function_Callable(Function_Definition::Ptr fd): definition { std::move(fd) } { }
+    Function_Callable(Function_Definition::Ptr fd, std::vector<Value> cells):
+        definition { std::move(fd) }, cells_ { std::move(cells) }
+    { }
+
+    [[nodiscard]] std::size_t size() const override {
+        return sizeof(Function_Callable) + cells_.capacity() * sizeof(Value);
+    }
+
+    void trace(Gc_Tracer &tracer) const override {
+        for (const auto &cell : cells_) { cell.trace(tracer); }
+        memo_.trace(tracer);
+    }
+
+    void clear() override {
+        cells_.clear();
+        memo_.clear();
+    }
 
-    Literal::Ptr call(Interpreter &interpreter, const std::vector<Literal::Ptr> &arguments) const override;
+    Value call(Interpreter &interpreter, std::span<const Value> arguments) const override;
 
-    explicit operator std::string() const override { return "<fn " + definition->name.lexeme + ">"; }
+    explicit operator std::string() const override { return "<fn " + definition->name.lexeme() + ">"; }
 
     [[nodiscard]] int arity() const override { return static_cast<int>(definition->params.size()); }
 };
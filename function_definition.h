@@ -3,23 +3,63 @@
 #include "statement.h"
 
 #include <memory>
+#include <string>
 #include <utility>
 #include <vector>
 
 #include "block_statement.h"
 #include "expression.h"
-#include "token.h"
+#include "identifier.h"
+#include "symbol.h"
+
+// Methods get the instance as a hidden first argument, in slot 0 of the
+// frame before the parameters; an initializer returns it.
+enum class Function_Kind { FUNCTION, METHOD, INITIALIZER };
 
 class Function_Definition: public Statement, public std::enable_shared_from_this<Function_Definition> {
 public:
     using Ptr = std::shared_ptr<const Function_Definition>;
 
-    const Token name;
-    const std::vector<Token> params;
+    const Identifier name;
+    const std::vector<Identifier> params;
     const Block_Statement::Ptr body;
+    const Function_Kind kind;
+
+    // A variable of an enclosing function the body refers to: where the
+    // enclosing function holds its Cell when this one is defined, either
+    // environment hops and slot or, with depth < 0, an index into its own
+    // captures.
+    struct Capture {
+        Symbol name;
+        int depth;
+        int slot;
+    };
+
+    // slot of the function name (< 0 for globals) and size of the call frame; set by the Resolver
+    mutable int slot = -1;
+    mutable int frame_size = 0;
+    // also set by the Resolver: whether a nested function captures the name,
+    // the slots of the parameters nested functions capture, and the
+    // variables this function captures itself
+    mutable bool captured = false;
+    mutable std::vector<int> captured_params;
+    mutable std::vector<Capture> captures;
+    // and the name of the class a method is defined in
+    mutable std::string owner;
+
+    // set by Purity: the body has no side effects and reads nothing but its
+    // arguments, provided the global functions it calls by these names
+    // are pure too
+    mutable bool pure = false;
+    mutable std::vector<Symbol> callees;
+
+    Function_Definition(const Identifier &n, std::vector<Identifier> &&p, Block_Statement::Ptr b, Function_Kind k = Function_Kind::FUNCTION):
+            name { n }, params { std::move(p) }, body { std::move(b) }, kind { k } { }
+
+    [[nodiscard]] bool is_method() const { return kind != Function_Kind::FUNCTION; }
 
-    Function_Definition(const Token &n, std::vector<Token> &&p, Block_Statement::Ptr b):
-            name { n }, params { std::move(p) }, body { std::move(b) } { }
+    // how --profile names it: Class.method for a method
+    [[nodiscard]] std::string label() const { return owner.empty() ? name.lexeme() : owner + "." + name.lexeme(); }
 
     void accept(Statement_Visitor &visitor) const override { visitor.visit(*this); }
 
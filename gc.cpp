@@ -0,0 +1,76 @@
+#include "gc.h"
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+Gc_Node::Gc_Node() { Heap::instance().track(this); }
+
+Gc_Node::~Gc_Node() { Heap::instance().untrack(this); }
+
+class Heap::Subtract: public Gc_Tracer {
+    public:
+        void operator()(const Gc_Node *node) override { --node->gc_refs_; }
+};
+
+class Heap::Mark: public Gc_Tracer {
+        std::vector<const Gc_Node *> pending_;
+
+    public:
+        void operator()(const Gc_Node *node) override {
+            if (node->marked_) { return; }
+            node->marked_ = true;
+            pending_.push_back(node);
+        }
+
+        void drain() {
+            while (! pending_.empty()) {
+                const Gc_Node *node { pending_.back() };
+                pending_.pop_back();
+                node->trace(*this);
+            }
+        }
+};
+
+void Heap::collect() {
+    if (collecting_) { return; }
+    collecting_ = true;
+    auto start { std::chrono::steady_clock::now() };
+
+    // references other nodes do not account for come from outside the heap
+    for (Gc_Node *node { first_ }; node; node = node->next_) {
+        node->gc_refs_ = node->refs_;
+        node->marked_ = false;
+    }
+    Subtract subtract;
+    for (Gc_Node *node { first_ }; node; node = node->next_) { node->trace(subtract); }
+
+    Mark mark;
+    for (Gc_Node *node { first_ }; node; node = node->next_) {
+        if (node->gc_refs_ > 0) { mark(node); }
+    }
+    mark.drain();
+
+    // the rest is only referenced from within cycles of garbage; holding
+    // each node while all of them drop their references keeps them from
+    // being freed half way
+    std::vector<Gc_Node *> garbage;
+    for (Gc_Node *node { first_ }; node; node = node->next_) {
+        if (! node->marked_) {
+            ++node->refs_;
+            garbage.push_back(node);
+        }
+    }
+    for (Gc_Node *node : garbage) { node->clear(); }
+    for (Gc_Node *node : garbage) {
+        if (--node->refs_ == 0) { delete node; }
+    }
+
+    std::chrono::duration<double> pause { std::chrono::steady_clock::now() - start };
+    ++stats.collections;
+    stats.pause_seconds += pause.count();
+    stats.max_pause_seconds = std::max(stats.max_pause_seconds, pause.count());
+    allocated_ = 0;
+    next_collection_ = std::max(min_collection, live_bytes_);
+    collecting_ = false;
+}
@@ -0,0 +1,164 @@
+#pragma once
+
+#include <cstddef>
+#include <utility>
+
+#include "pool.h"
+
+class Gc_Node;
+class Heap;
+class Value;
+
+// Called for every node another node references.
+class Gc_Tracer {
+    public:
+        virtual void operator()(const Gc_Node *node) = 0;
+
+    protected:
+        ~Gc_Tracer() = default;
+};
+
+// Anything on the runtime heap: objects and environments. Nodes are
+// reference counted, which frees most garbage as soon as it is dropped;
+// the Heap tracks them all and collects the cycles counting cannot free.
+class Gc_Node {
+        friend class Heap;
+        friend class Value;
+        template<typename T> friend class Ref;
+
+        mutable int refs_ = 0;
+        // set during a collection: references from outside other nodes,
+        // and whether the node is reachable
+        mutable int gc_refs_ = 0;
+        mutable bool marked_ = false;
+        mutable std::size_t bytes_ = 0;
+        mutable Gc_Node *prev_ = nullptr;
+        mutable Gc_Node *next_ = nullptr;
+
+    public:
+        Gc_Node();
+        Gc_Node(const Gc_Node &) = delete;
+        Gc_Node &operator=(const Gc_Node &) = delete;
+        virtual ~Gc_Node();
+
+        // nodes come from the Pool; the virtual destructor hands delete the
+        // size of the whole node
+        static void *operator new(std::size_t size) { return Pool::allocate(size); }
+        static void operator delete(void *pointer, std::size_t size) { Pool::deallocate(pointer, size); }
+
+        // approximate bytes the node occupies, for collection pacing and
+        // --gc-stats
+        [[nodiscard]] virtual std::size_t size() const = 0;
+
+        // reports every node this one references
+        virtual void trace(Gc_Tracer &tracer) const { }
+
+        // drops the references this node holds; only called on garbage, to
+        // break the cycles it is part of
+        virtual void clear() { }
+};
+
+// The set of all nodes and the collector over it. There are no explicit
+// roots: whatever references a node beyond what other nodes account for,
+// like a Value on the C++ stack, in the globals or the interpreter's
+// environment, makes it a root. A collection marks what the roots reach and
+// clears the rest. Collections run after a volume of allocation that grows
+// with the live heap, or after every allocation in stress mode.
+class Heap {
+        Gc_Node *first_ = nullptr;
+        std::size_t live_nodes_ = 0;
+        std::size_t live_bytes_ = 0;
+        std::size_t allocated_ = 0;
+        std::size_t next_collection_ = min_collection;
+        bool collecting_ = false;
+
+        class Subtract;
+        class Mark;
+
+        Heap() = default;
+
+    public:
+        static constexpr std::size_t min_collection { 1024 * 1024 };
+
+        struct Stats {
+            std::size_t collections = 0;
+            std::size_t freed_nodes = 0;
+            std::size_t freed_bytes = 0;
+            double pause_seconds = 0;
+            double max_pause_seconds = 0;
+            // nodes ever made and the most alive at once
+            std::size_t allocated_nodes = 0;
+            std::size_t peak_nodes = 0;
+        };
+
+        static inline bool stress = false;
+        Stats stats;
+
+        // The heap of the calling thread; nodes never move between threads.
+        // Constant initialized and never destroyed, so using it costs no
+        // guard and the symbol table can still free its strings as the
+        // thread ends.
+        static Heap &instance() {
+            static thread_local Heap heap;
+            return heap;
+        }
+
+        [[nodiscard]] std::size_t live_nodes() const { return live_nodes_; }
+        [[nodiscard]] std::size_t live_bytes() const { return live_bytes_; }
+
+        void track(Gc_Node *node) {
+            ++stats.allocated_nodes;
+            if (++live_nodes_ > stats.peak_nodes) { stats.peak_nodes = live_nodes_; }
+            node->next_ = first_;
+            if (first_) { first_->prev_ = node; }
+            first_ = node;
+        }
+
+        void untrack(Gc_Node *node) {
+            if (node->prev_) { node->prev_->next_ = node->next_; } else { first_ = node->next_; }
+            if (node->next_) { node->next_->prev_ = node->prev_; }
+            --live_nodes_;
+            live_bytes_ -= node->bytes_;
+            if (collecting_) {
+                ++stats.freed_nodes;
+                stats.freed_bytes += node->bytes_;
+            }
+        }
+
+        // counts a node that was just built and is referenced from where it
+        // was built, which makes this a safe point to collect
+        void allocated(const Gc_Node *node) {
+            node->bytes_ = node->size();
+            live_bytes_ += node->bytes_;
+            allocated_ += node->bytes_;
+            if (stress || allocated_ >= next_collection_) { collect(); }
+        }
+
+        void collect();
+};
+
+
+// An owning reference to a heap node other than through a Value.
+template<typename T> class Ref {
+        T *node_ = nullptr;
+
+    public:
+        Ref() = default;
+        Ref(std::nullptr_t) { }
+        explicit Ref(T *node): node_ { node } { if (node_) { ++node_->refs_; } }
+        Ref(const Ref &other): Ref { other.node_ } { }
+        Ref(Ref &&other) noexcept: node_ { other.node_ } { other.node_ = nullptr; }
+        Ref &operator=(Ref other) noexcept { std::swap(node_, other.node_); return *this; }
+        ~Ref() { if (node_ && --node_->refs_ == 0) { delete node_; } }
+
+        [[nodiscard]] T *get() const { return node_; }
+        T *operator->() const { return node_; }
+        T &operator*() const { return *node_; }
+        explicit operator bool() const { return node_ != nullptr; }
+};
+
+template<typename T, typename... Args> Ref<T> make_ref(Args &&... args) {
+    Ref<T> ref { new T(std::forward<Args>(args)...) };
+    Heap::instance().allocated(ref.get());
+    return ref;
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include "expression.h"
+
+#include <memory>
+#include <utility>
+
+#include "identifier.h"
+#include "shape.h"
+
+class Get_Expression: public Expression {
+public:
+    const Expression::Ptr object;
+    const Identifier name;
+
+    // the shape seen here last and where the property was; set by the Interpreter
+    mutable Property_Cache cache;
+
+    Get_Expression(Expression::Ptr o, const Identifier &n): object { std::move(o) }, name { n } { }
+
+    void accept(Expression_Visitor &visitor) const override { visitor.visit(*this); }
+};
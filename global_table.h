@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "symbol.h"
+#include "value.h"
+
+// Globals by slot. A name keeps its slot for the life of the table, so code
+// can look it up once and use the index from then on.
+class Global_Table {
+        std::unordered_map<Symbol, int> slots_;
+
+    public:
+        std::vector<Symbol> names;
+        std::vector<Value> values;
+        std::vector<bool> defined;
+        // bumped on every write; a cache that saw a slot at some version
+        // still sees the same value while the version is unchanged
+        std::vector<std::uint32_t> versions;
+
+        int slot(Symbol name) {
+            auto got { slots_.find(name) };
+            if (got != slots_.end()) { return got->second; }
+            int index { static_cast<int>(names.size()) };
+            slots_.emplace(name, index);
+            names.push_back(name);
+            values.emplace_back();
+            defined.push_back(false);
+            versions.push_back(0);
+            return index;
+        }
+
+        void set(int index, Value value) {
+            values[index] = std::move(value);
+            defined[index] = true;
+            ++versions[index];
+        }
+
+        void define(Symbol name, Value value) { set(slot(name), std::move(value)); }
+};
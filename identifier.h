@@ -0,0 +1,16 @@
+#pragma once
+
+#include "symbol.h"
+#include "token.h"
+
+// The part of an identifier token that AST nodes keep.
+class Identifier {
+    public:
+        Symbol symbol;
+        int line;
+
+        Identifier(const Token &token): symbol { token.symbol }, line { token.line } { }
+        Identifier(Symbol s, int l): symbol { s }, line { l } { }
+
+        [[nodiscard]] const std::string &lexeme() const { return Symbol_Table::instance().name(symbol); }
+};
@@ -1,32 +1,51 @@
 #pragma once
 
-#include <iostream>
+#include <chrono>
+#include <cmath>
+#include <ostream>
+#include <map>
+#include <span>
+#include <string>
+#include <string_view>
 #include <utility>
 #include <vector>
 
+#include "argument_stack.h"
 #include "assign_expression.h"
 #include "binary_expression.h"
 #include "block_statement.h"
 #include "call_expression.h"
 #include "callable_literal.h"
+#include "cell.h"
+#include "class_statement.h"
 #include "environment.h"
 #include "err.h"
 #include "expression.h"
 #include "expression_statement.h"
 #include "function_callable.h"
+#include "get_expression.h"
+#include "global_table.h"
 #include "grouping.h"
 #include "if_statement.h"
 #include "literal.h"
+#include "lox_class.h"
+#include "object.h"
 #include "logical_expression.h"
+#include "memo_table.h"
+#include "native_function.h"
 #include "print_statement.h"
 #include "return_statement.h"
+#include "set_expression.h"
 #include "statement.h"
+#include "super_expression.h"
+#include "this_expression.h"
+#include "identifier.h"
 #include "token.h"
 #include "unary.h"
 #include "var_statement.h"
+#include "value.h"
 #include "var_expression.h"
 #include "while_statement.h"
-#include "clock_callable.h"
 
 class Interpreter;
 
@@ -35,129 +54,300 @@ class Env_Handler {
         Environment::Ptr old_;
 
     public:
-        explicit Env_Handler(Interpreter &i);
         Env_Handler(Interpreter &i, Environment::Ptr new_env);
         ~Env_Handler();
 };
 
 class Interpreter: public Expression_Visitor, public Statement_Visitor {
-    Literal::Ptr value_;
+    // how execution of the current statement ended; anything but NORMAL
+    // unwinds the enclosing statements up to the next call or the top level
+    enum class Completion { NORMAL, RETURN, TAIL_CALL, ERROR };
+
+    Value value_;
     Environment::Ptr environment_;
+    // the cells of the closure whose body is running
+    const std::vector<Value> *cells_ = nullptr;
+    Completion completion_ = Completion::NORMAL;
+    Value return_value_;
+    Value tail_callee_;
+    std::vector<Value> tail_arguments_;
+    // the arguments of the calls in progress, and the line of the last one
+    // made, for errors natives report
+    Argument_Stack arguments_;
+    int call_line_ = 0;
+    int error_line_ = 0;
+    std::string error_message_;
+    // where the program's output and errors go
+    Reporter &reporter_;
+    std::ostream &out_;
+
+    bool check_number_operand(const Node_Token &token, const Value &right);
+    bool check_number_operands(const Node_Token &token, const Value &left, const Value &right);
+
+    friend class Env_Handler;
+    friend class Jit;
+
+    // the global slot an identifier refers to, cached on the node after the
+    // first lookup
+    int global_slot(const Identifier &name, int &cache) {
+        if (cache >= 0) {
+            ++stats.global_hits;
+        } else {
+            ++stats.global_misses;
+            cache = globals.slot(name.symbol);
+        }
+        return cache;
+    }
+
+public:
+    struct Stats {
+        std::size_t global_hits = 0;
+        std::size_t global_misses = 0;
+        std::size_t call_hits = 0;
+        std::size_t call_misses = 0;
+        std::size_t property_hits = 0;
+        std::size_t property_misses = 0;
+        std::size_t jit_compiled = 0;
+        // Lox function bodies run, the calls now on the stack (a tail
+        // call replaces its caller) and the most there were
+        std::size_t calls = 0;
+        std::size_t depth = 0;
+        std::size_t peak_depth = 0;
+        std::size_t environments = 0;
+        // --memoize results reused, by function name
+        std::map<std::string, Memo_Table::Stats> memo;
+    };
+
+    Global_Table globals;
+    Stats stats;
+
+    Interpreter(Reporter &reporter, std::ostream &out): reporter_ { reporter }, out_ { out } {
+        define_native("clock", [] {
+            auto since_epoch { std::chrono::system_clock::now().time_since_epoch() };
+            return static_cast<double>(std::chrono::duration_cast<std::chrono::milliseconds>(since_epoch).count()) / 1000.0;
+        });
+        define_native("sqrt", [](double x) { return std::sqrt(x); });
+        define_native("floor", [](double x) { return std::floor(x); });
+        define_native("len", [](std::string_view s) { return static_cast<double>(s.size()); });
+    }
+
+    // Defines a global native function; see Native_Function for what the
+    // function may take and return.
+    template<typename F> void define_native(std::string_view name, F function) {
+        globals.define(
+            Symbol_Table::instance().intern(name), Value::make<Native_Function<F>>(std::string { name }, std::move(function))
+        );
+    }
+
+    [[nodiscard]] Reporter &reporter() const { return reporter_; }
+    [[nodiscard]] std::ostream &out() const { return out_; }
 
-    static bool is_truthy(const Literal::Ptr &literal) {
-        if (! literal) { return false; }
-        if (literal->is_bool()) { return literal->as_bool(); }
+    [[nodiscard]] bool unwinding() const { return completion_ != Completion::NORMAL; }
+
+    void fail(int line, std::string message) {
+        completion_ = Completion::ERROR;
+        error_line_ = line;
+        error_message_ = std::move(message);
+    }
+
+    // fails the call a native is running
+    void fail_call(std::string message) { fail(call_line_, std::move(message)); }
+
+    // The message of a runtime error, for the VM to report its own way.
+    bool take_error(std::string &message) {
+        if (completion_ != Completion::ERROR) { return false; }
+        completion_ = Completion::NORMAL;
+        message = std::move(error_message_);
         return true;
     }
 
-    static bool is_equal(const Literal::Ptr &a, const Literal::Ptr &b) {
-        if (! a) { return ! b; }
-        if (a->is_bool()) { return b->is_bool() && a->as_bool() == b->as_bool(); }
-        if (a->is_string()) { return b->is_string() && a->as_string() == b->as_string(); }
-        if (a->is_number()) { return b->is_number() && a->as_number() == b->as_number(); }
-        return false;
+    // calls a method with the instance it runs on ahead of the arguments
+    Value call_method(const Value &method, const Value &receiver, std::span<const Value> arguments) {
+        Argument_Stack::Frame frame { arguments_, arguments.size() + 1 };
+        frame.push(receiver);
+        for (const auto &argument : arguments) { frame.push(argument); }
+        return method.as<Callable_Literal>().call(*this, frame.values());
     }
 
-    static void check_number_operand(const Token &token, const Literal::Ptr &right);
-    static void check_number_operands(const Token &token, const Literal::Ptr &left, const Literal::Ptr &right);
+    Value finish_call() {
+        if (completion_ != Completion::RETURN) { return {}; }
+        completion_ = Completion::NORMAL;
+        return std::move(return_value_);
+    }
 
-    friend class Env_Handler;
+    void evaluate(const Expression::Ptr &expression) {
+        if (expression) { expression->accept(*this); } else { value_ = {}; }
+    }
 
-public:
-    Environment::Ptr globals;
+    static Binary_Expression::Specialization specialize(Token_Type type, const Value &left, const Value &right) {
+        using Specialization = Binary_Expression::Specialization;
+        if (left.is_string() && right.is_string() && type == Token_Type::PLUS) { return Specialization::STRING_CONCAT; }
+        if (! left.is_number() || ! right.is_number()) { return Specialization::GENERIC; }
+        switch (type) {
+            case Token_Type::PLUS: return Specialization::NUMBER_ADD;
+            case Token_Type::MINUS: return Specialization::NUMBER_SUBTRACT;
+            case Token_Type::STAR: return Specialization::NUMBER_MULTIPLY;
+            case Token_Type::SLASH: return Specialization::NUMBER_DIVIDE;
+            case Token_Type::GREATER: return Specialization::NUMBER_GREATER;
+            case Token_Type::GREATER_EQUAL: return Specialization::NUMBER_GREATER_EQUAL;
+            case Token_Type::LESS: return Specialization::NUMBER_LESS;
+            case Token_Type::LESS_EQUAL: return Specialization::NUMBER_LESS_EQUAL;
+            default: return Specialization::GENERIC;
+        }
+    }
 
-    class Exception: public std::domain_error {
-        public:
-            const Token token;
-            Exception(const Token &t, const std::string& m): std::domain_error { m }, token { t } { }
-    };
+    static Binary_Expression::Operand classify(const Expression::Ptr &expression) {
+        using Operand = Binary_Expression::Operand;
+        if (auto var { dynamic_cast<const Var_Expression *>(expression.get()) }; var && var->depth >= 0 && ! var->boxed) {
+            return Operand::LOCAL;
+        }
+        if (dynamic_cast<const Number_Literal *>(expression.get())) { return Operand::NUMBER; }
+        return Operand::NODE;
+    }
 
-    class Return: public std::runtime_error {
-        public:
-            const Literal::Ptr value;
-            explicit Return(Literal::Ptr v) : runtime_error("return called"), value{std::move(v)} { }
-    };
+    // Evaluates an operand, reading locals and number constants directly.
+    void evaluate(const Expression::Ptr &expression, Binary_Expression::Operand operand) {
+        switch (operand) {
+            case Binary_Expression::Operand::LOCAL: {
+                const auto &var { static_cast<const Var_Expression &>(*expression) };
+                value_ = environment_->at(var.depth, var.slot);
+                return;
+            }
+            case Binary_Expression::Operand::NUMBER:
+                value_ = Value { static_cast<const Number_Literal &>(*expression).value };
+                return;
+            default:
+                evaluate(expression);
+        }
+    }
 
-    Interpreter() {
-        globals = std::make_shared<Environment>();
-        globals->define("clock", std::make_shared<Clock_Callable>());
+    // Runs the fast path the node specialized on. Returns false if the
+    // generic path has to evaluate it instead.
+    bool evaluate_specialized(const Binary_Expression &binary, const Value &left, const Value &right) {
+        using Specialization = Binary_Expression::Specialization;
+        switch (binary.specialization) {
+            case Specialization::UNSEEN:
+                binary.specialization = specialize(binary.token.type, left, right);
+                binary.left_operand = classify(binary.left);
+                binary.right_operand = classify(binary.right);
+                return false;
+            case Specialization::GENERIC:
+                return false;
+            case Specialization::STRING_CONCAT:
+                if (left.is_string() && right.is_string()) {
+                    value_ = Value::make<String_Object>(left.as_string() + right.as_string());
+                    return true;
+                }
+                break;
+            default:
+                if (left.is_number() && right.is_number()) {
+                    double a { left.as_number() };
+                    double b { right.as_number() };
+                    switch (binary.specialization) {
+                        case Specialization::NUMBER_ADD: value_ = Value { a + b }; break;
+                        case Specialization::NUMBER_SUBTRACT: value_ = Value { a - b }; break;
+                        case Specialization::NUMBER_MULTIPLY: value_ = Value { a * b }; break;
+                        case Specialization::NUMBER_DIVIDE: value_ = Value { a / b }; break;
+                        case Specialization::NUMBER_GREATER: value_ = Value { a > b }; break;
+                        case Specialization::NUMBER_GREATER_EQUAL: value_ = Value { a >= b }; break;
+                        case Specialization::NUMBER_LESS: value_ = Value { a < b }; break;
+                        case Specialization::NUMBER_LESS_EQUAL: value_ = Value { a <= b }; break;
+                        default: break;
+                    }
+                    return true;
+                }
+                break;
+        }
+        binary.specialization = Specialization::GENERIC;
+        return false;
     }
 
     void visit(const Binary_Expression &binary) override {
-        binary.left->accept(*this);
-        Literal::Ptr left = std::move(value_);
-        binary.right->accept(*this);
-        Literal::Ptr right = std::move(value_);
+        evaluate(binary.left, binary.left_operand);
+        if (unwinding()) { return; }
+        Value left = std::move(value_);
+        evaluate(binary.right, binary.right_operand);
+        if (unwinding()) { return; }
+        Value right = std::move(value_);
+
+        if (evaluate_specialized(binary, left, right)) { return; }
+        apply(binary, left, right);
+    }
 
+    // the generic binary operation on evaluated operands
+    void apply(const Binary_Expression &binary, const Value &left, const Value &right) {
         switch (binary.token.type) {
             case Token_Type::GREATER:
-                check_number_operands(binary.token, left, right);
-                value_ = Literal::create(left->as_number() > right->as_number());
+                if (! check_number_operands(binary.token, left, right)) { return; }
+                value_ = Value { left.as_number() > right.as_number() };
                 return;
             case Token_Type::GREATER_EQUAL:
-                check_number_operands(binary.token, left, right);
-                value_ = Literal::create(left->as_number() >= right->as_number());
+                if (! check_number_operands(binary.token, left, right)) { return; }
+                value_ = Value { left.as_number() >= right.as_number() };
                 return;
             case Token_Type::LESS:
-                check_number_operands(binary.token, left, right);
-                value_ = Literal::create(left->as_number() < right->as_number());
+                if (! check_number_operands(binary.token, left, right)) { return; }
+                value_ = Value { left.as_number() < right.as_number() };
                 return;
             case Token_Type::LESS_EQUAL:
-                check_number_operands(binary.token, left, right);
-                value_ = Literal::create(left->as_number() <= right->as_number());
+                if (! check_number_operands(binary.token, left, right)) { return; }
+                value_ = Value { left.as_number() <= right.as_number() };
                 return;
             case Token_Type::BANG_EQUAL:
-                check_number_operands(binary.token, left, right);
-                value_ = Literal::create(!is_equal(left, right));
+                value_ = Value { left != right };
                 return;
             case Token_Type::EQUAL_EQUAL:
-                check_number_operands(binary.token, left, right);
-                value_ = Literal::create(is_equal(left, right));
+                value_ = Value { left == right };
                 return;
             case Token_Type::MINUS:
-                check_number_operands(binary.token, left, right);
-                value_ = Literal::create(left->as_number() - right->as_number());
+                if (! check_number_operands(binary.token, left, right)) { return; }
+                value_ = Value { left.as_number() - right.as_number() };
                 return;
             case Token_Type::PLUS:
-                if (left && right && left->is_number() && right->is_number()) {
-                    value_ = Literal::create(left->as_number() + right->as_number());
+                if (left.is_number() && right.is_number()) {
+                    value_ = Value { left.as_number() + right.as_number() };
                     return;
                 }
-                if (left && right && left->is_string() && right->is_string()) {
-                    value_ = Literal::create(left->as_string() + right->as_string());
+                if (left.is_string() && right.is_string()) {
+                    value_ = Value::make<String_Object>(left.as_string() + right.as_string());
                     return;
                 }
-                throw Exception { binary.token, "Operands must be two numbers or two strings." };
+                fail(binary.token.line, "Operands must be two numbers or two strings.");
+                return;
             case Token_Type::SLASH:
-                check_number_operands(binary.token, left, right);
-                value_ = Literal::create(left->as_number() / right->as_number());
+                if (! check_number_operands(binary.token, left, right)) { return; }
+                value_ = Value { left.as_number() / right.as_number() };
                 return;
             case Token_Type::STAR:
-                check_number_operands(binary.token, left, right);
-                value_ = Literal::create(left->as_number() * right->as_number());
+                if (! check_number_operands(binary.token, left, right)) { return; }
+                value_ = Value { left.as_number() * right.as_number() };
                 return;
             default: break;
         }
     }
 
     void visit(const Grouping &grouping) override {
-        grouping.expression->accept(*this);
+        evaluate(grouping.expression);
     }
 
     void visit(const Literal &literal) override {
-        value_ = literal.shared();
+        value_ = literal.to_value();
     }
 
     void visit(const Unary &unary) override {
-        unary.right->accept(*this);
-        Literal::Ptr right = std::move(value_);
+        evaluate(unary.right);
+        if (unwinding()) { return; }
+        apply(unary, std::move(value_));
+    }
+
+    void apply(const Unary &unary, Value right) {
         switch (unary.token.type) {
             case Token_Type::BANG:
-                value_ = Literal::create(! is_truthy(value_));
+                value_ = Value { ! right.is_truthy() };
                 return;
             case Token_Type::MINUS:
-                check_number_operand(unary.token, right);
-                value_ = Literal::create(-right->as_number());
+                if (! check_number_operand(unary.token, right)) { return; }
+                value_ = Value { -right.as_number() };
                 return;
             default:
                 break;
@@ -165,12 +355,22 @@ public:
     }
 
     void visit(const Var_Expression &expression) override {
-        value_ = environment_->get(expression.name);
+        if (expression.depth >= 0) {
+            const Value &value { environment_->at(expression.depth, expression.slot) };
+            value_ = expression.boxed ? value.as<Cell>().value : value;
+        } else if (expression.upvalue >= 0) {
+            value_ = (*cells_)[expression.upvalue].as<Cell>().value;
+        } else if (int slot { global_slot(expression.name, expression.global) }; globals.defined[slot]) {
+            value_ = globals.values[slot];
+        } else {
+            fail(expression.name.line, "Undefined variable '" + expression.name.lexeme() + "'.");
+        }
     }
 
     void visit(const Print_Statement &statement) override {
-        if (statement.expression) { statement.expression->accept(*this); } else { value_ = {}; }
-        std::cout << Literal::to_string(value_) << "\n";
+        evaluate(statement.expression);
+        if (unwinding()) { return; }
+        out_ << value_.to_string() << "\n";
     }
 
     void visit(const Expression_Statement &statement) override {
@@ -178,119 +378,353 @@ public:
     }
 
     void visit(const Var_Statement &statement) override {
-        Literal::Ptr initializer;
+        Value initializer;
         if (statement.initializer) {
-            statement.initializer->accept(*this);
+            evaluate(statement.initializer);
+            if (unwinding()) { return; }
             initializer = std::move(value_);
         }
-        environment_->define(statement.name.lexeme, std::move(initializer));
+        define(statement.slot, statement.captured, statement.name, std::move(initializer));
     }
 
     void visit(const Assign_Expression &statement) override {
-        statement.value->accept(*this);
-        environment_->assign(statement.name, value_);
+        evaluate(statement.value);
+        if (unwinding()) { return; }
+        if (statement.depth >= 0) {
+            Value &value { environment_->at(statement.depth, statement.slot) };
+            if (statement.boxed) { value.as<Cell>().value = value_; } else { value = value_; }
+        } else if (statement.upvalue >= 0) {
+            (*cells_)[statement.upvalue].as<Cell>().value = value_;
+        } else {
+            assign_global(statement, value_);
+        }
     }
 
-    void execute_block(const Block_Statement &statement, Environment::Ptr env) {
-        Env_Handler env_handler { *this, std::move(env) };
-        for (const auto &s : statement.statements) {
+    void assign_global(const Assign_Expression &statement, Value value) {
+        if (int slot { global_slot(statement.name, statement.global) }; globals.defined[slot]) {
+            globals.set(slot, std::move(value));
+        } else {
+            fail(statement.name.line, "Undefined variable '" + statement.name.lexeme() + "'.");
+        }
+    }
+
+    void define(int slot, bool captured, const Identifier &name, Value value) {
+        if (slot < 0) {
+            globals.define(name.symbol, std::move(value));
+        } else if (captured) {
+            cell(environment_->slots_[slot]).value = std::move(value);
+        } else {
+            environment_->slots_[slot] = std::move(value);
+        }
+    }
+
+    // the Cell of a captured variable, made on its first declaration
+    static const Cell &cell(Value &slot) {
+        if (! slot.is_object(Object_Type::CELL)) { slot = Value::make<Cell>(); }
+        return slot.as<Cell>();
+    }
+
+    void execute(const std::vector<Statement::Ptr> &statements) {
+        for (const auto &s : statements) {
             if (s) { s->accept(*this); }
+            if (unwinding()) { return; }
         }
     }
 
+    void execute_block(const std::vector<Statement::Ptr> &statements, Environment::Ptr env) {
+        Env_Handler env_handler { *this, std::move(env) };
+        execute(statements);
+    }
+
+    // runs a function body in its frame, with the cells of its closure
+    void execute_body(const std::vector<Statement::Ptr> &statements, Environment::Ptr env, const std::vector<Value> &cells) {
+        const std::vector<Value> *enclosing { std::exchange(cells_, &cells) };
+        execute_block(statements, std::move(env));
+        cells_ = enclosing;
+    }
+
     void visit(const Block_Statement &statement) override {
-        Env_Handler env_handler { *this };
-        execute_block(statement, environment_);
+        if (statement.frame_size > 0) {
+            ++stats.environments;
+            execute_block(statement.statements, make_ref<Environment>(environment_, statement.frame_size));
+        } else {
+            execute(statement.statements);
+        }
     }
 
     void visit(const If_Statement &statement) override {
-        if (statement.condition) { statement.condition->accept(*this); } else { value_ = {}; }
-        if (is_truthy(value_)) {
+        evaluate(statement.condition);
+        if (unwinding()) { return; }
+        if (value_.is_truthy()) {
             if (statement.then_branch) { statement.then_branch->accept(*this); }
         } else if (statement.else_branch) {
             statement.else_branch->accept(*this);
         }
-        value_ = {};
     }
 
     void visit(const Logical_Expression &statement) override {
-        if (statement.left) { statement.left->accept(*this); } else { value_ = {}; }
+        evaluate(statement.left);
+        if (unwinding()) { return; }
         if (statement.token.type == Token_Type::OR) {
-            if (is_truthy(value_)) { return; }
+            if (value_.is_truthy()) { return; }
         } else {
-            if (!is_truthy(value_)) { return; }
+            if (! value_.is_truthy()) { return; }
         }
-        if (statement.right) { statement.right->accept(*this); } else { value_ = {}; }
+        evaluate(statement.right);
     }
 
     void visit(const While_Statement &statement) override {
         for (;;) {
-            if (statement.condition) { statement.condition->accept(*this); } else { value_ = {}; }
-            if (! is_truthy(value_)) { break; }
+            evaluate(statement.condition);
+            if (unwinding() || ! value_.is_truthy()) { break; }
             if (statement.body) { statement.body->accept(*this); }
+            if (unwinding()) { break; }
         }
     }
 
-    void visit(const Call_Expression &expr) override {
-        if (expr.callee) { expr.callee->accept(*this); } else { value_ = { }; }
-        Literal::Ptr callee = std::move(value_);
+    // Evaluates the callee and the arguments of a call and checks that they
+    // fit. Returns false on a runtime error.
+    bool prepare_call(const Call_Expression &expr, Value &callee, Argument_Stack::Frame &arguments) {
+        // a global callee that has not been written since it was checked
+        // needs neither the lookup nor the checks again
+        bool cached { expr.global >= 0 && globals.versions[expr.global] == expr.version };
+        // a method takes the instance as its first argument
+        bool method { false };
+        if (cached) {
+            ++stats.call_hits;
+            callee = globals.values[expr.global];
+        } else if (expr.method) {
+            ++stats.call_misses;
+            if (! prepare_method(*expr.method, callee, arguments, method)) { return false; }
+        } else {
+            ++stats.call_misses;
+            evaluate(expr.callee);
+            if (unwinding()) { return false; }
+            callee = std::move(value_);
+        }
 
-        std::vector<Literal::Ptr> arguments;
         for (const auto &arg: expr.arguments) {
-            if (arg) { arg->accept(*this); } else { value_ = { }; }
-            arguments.push_back(std::move(value_));
+            evaluate(arg);
+            if (unwinding()) { return false; }
+            arguments.push(std::move(value_));
+        }
+        call_line_ = expr.paren.line;
+
+        if (! cached) {
+            if (! check_call(expr, callee, arguments.size() - (method ? 1 : 0))) { return false; }
+            auto var { dynamic_cast<const Var_Expression *>(expr.callee.get()) };
+            if (var && var->depth < 0 && var->upvalue < 0) {
+                expr.global = var->global;
+                expr.version = globals.versions[var->global];
+            }
+        }
+        return true;
+    }
+
+    // Looks up the callee of a call like instance.name(...). A method is
+    // called on the instance directly, without a Bound_Method in between.
+    bool prepare_method(const Get_Expression &get, Value &callee, Argument_Stack::Frame &arguments, bool &method) {
+        evaluate(get.object);
+        if (unwinding()) { return false; }
+        Value object { std::move(value_) };
+        const Value *property { lookup(get, object, method) };
+        if (! property) { return false; }
+        callee = *property;
+        if (method) { arguments.push(std::move(object)); }
+        return true;
+    }
+
+    // the field or method get names on an instance, null on a runtime error
+    const Value *lookup(const Get_Expression &get, const Value &object, bool &method) {
+        if (! object.is_object(Object_Type::INSTANCE)) {
+            fail(get.name.line, "Only instances have properties.");
+            return nullptr;
+        }
+        const auto &instance { object.as<Instance>() };
+        if (instance.shape.get() == get.cache.shape.get()) { ++stats.property_hits; } else { ++stats.property_misses; }
+        const Value *property { instance.get(get.name.symbol, get.cache, method) };
+        if (! property) { fail(get.name.line, "Undefined property '" + get.name.lexeme() + "'."); }
+        return property;
+    }
+
+    void visit(const Get_Expression &get) override {
+        evaluate(get.object);
+        if (unwinding()) { return; }
+        Value object { std::move(value_) };
+        bool method;
+        const Value *property { lookup(get, object, method) };
+        if (! property) { return; }
+        value_ = method ? Value::make<Bound_Method>(std::move(object), *property) : *property;
+    }
+
+    void visit(const Set_Expression &set) override {
+        evaluate(set.object);
+        if (unwinding()) { return; }
+        Value object { std::move(value_) };
+        if (! object.is_object(Object_Type::INSTANCE)) {
+            fail(set.name.line, "Only instances have fields.");
+            return;
+        }
+        evaluate(set.value);
+        if (unwinding()) { return; }
+        const auto &instance { object.as<Instance>() };
+        if (instance.shape.get() == set.cache.shape.get()) { ++stats.property_hits; } else { ++stats.property_misses; }
+        instance.set(set.name.symbol, value_, set.cache);
+    }
+
+    void visit(const This_Expression &expression) override { visit(static_cast<const Var_Expression &>(expression)); }
+
+    void visit(const Super_Expression &expression) override {
+        visit(expression.superclass);
+        Value superclass { std::move(value_) };
+        visit(expression.receiver);
+        const Value *method { superclass.as<Lox_Class>().find(expression.method.symbol) };
+        if (! method) {
+            fail(expression.method.line, "Undefined property '" + expression.method.lexeme() + "'.");
+            return;
         }
+        value_ = Value::make<Bound_Method>(std::move(value_), *method);
+    }
 
-        auto *fn = dynamic_cast<const Callable_Literal *>(&*callee);
-        if (! fn) {
-            throw Exception(expr.paren, "Can only call functions and classes.");
+    void visit(const Class_Statement &statement) override {
+        Value superclass;
+        if (statement.superclass) {
+            visit(*statement.superclass);
+            if (unwinding()) { return; }
+            if (! Lox_Class::is_class(value_)) {
+                fail(statement.superclass->name.line, "Superclass must be a class.");
+                return;
+            }
+            superclass = std::move(value_);
+        }
+        // methods that refer to the class capture its cell
+        if (statement.captured && statement.slot >= 0) { cell(environment_->slots_[statement.slot]); }
+
+        Lox_Class::Methods methods;
+        {
+            // the methods of a subclass capture super from a scope of its own
+            if (! superclass.is_nil()) { ++stats.environments; }
+            Env_Handler scope { *this, superclass.is_nil() ? environment_ : make_ref<Environment>(environment_, 1) };
+            if (! superclass.is_nil()) {
+                define(0, statement.super_captured, statement.superclass->name, superclass);
+            }
+            for (const auto &method : statement.methods) { methods.insert_or_assign(method->name.symbol, closure(*method)); }
         }
+        auto klass { Value::make<Lox_Class>(statement.name.lexeme(), std::move(superclass), std::move(methods), make_ref<const Shape>()) };
+        define(statement.slot, statement.captured, statement.name, std::move(klass));
+    }
+
+    void visit(const Call_Expression &expr) override {
+        Value callee;
+        Argument_Stack::Frame arguments { arguments_, expr.arguments.size() + 1 };
+        if (! prepare_call(expr, callee, arguments)) { return; }
+        value_ = callee.as<Callable_Literal>().call(*this, arguments.values());
+    }
+
+    // Leaves a call to a Lox function for the Function_Callable that is
+    // returning, which runs it in place of its own frame. Returns false for
+    // other callables, which the caller calls as usual.
+    bool defer_call(Value &callee, std::span<const Value> arguments) {
+        if (! dynamic_cast<const Function_Callable *>(callee.as_object())) { return false; }
+        tail_callee_ = std::move(callee);
+        tail_arguments_.assign(arguments.begin(), arguments.end());
+        completion_ = Completion::TAIL_CALL;
+        return true;
+    }
+
+    // Takes the call a function body ended with, if it ended with one. The
+    // vectors trade places, so neither allocates once both are grown.
+    bool take_tail_call(Value &callee, std::vector<Value> &arguments) {
+        if (completion_ != Completion::TAIL_CALL) { return false; }
+        completion_ = Completion::NORMAL;
+        callee = std::move(tail_callee_);
+        std::swap(arguments, tail_arguments_);
+        return true;
+    }
 
-        if (arguments.size() != fn->arity()) {
-            throw Exception(expr.paren, "Expected " + std::to_string(fn->arity()) + " arguments, but got " + std::to_string(arguments.size()) + ".");
+    bool check_call(const Call_Expression &expr, const Value &callee, std::size_t count) {
+        if (! callee.is_object(Object_Type::CALLABLE)) {
+            fail(expr.paren.line, "Can only call functions and classes.");
+            return false;
         }
-        value_ = fn->call(*this, arguments);
+        int arity { callee.as<Callable_Literal>().arity() };
+        if (count != arity) {
+            fail(expr.paren.line, "Expected " + std::to_string(arity) + " arguments, but got " + std::to_string(count) + ".");
+            return false;
+        }
+        return true;
     }
 
     void visit(const Function_Definition &definition) override {
-        auto fn = std::make_shared<Function_Callable>(definition.shared());
-        environment_->define(definition.name.lexeme, fn);
-        value_ = {};
+        // a function that refers to itself captures its own cell, so that
+        // has to exist first
+        if (definition.captured && definition.slot >= 0) { cell(environment_->slots_[definition.slot]); }
+        define(definition.slot, definition.captured, definition.name, closure(definition));
+    }
+
+    // a function with the cells of the variables it captures from here
+    Value closure(const Function_Definition &definition) {
+        std::vector<Value> cells;
+        for (const auto &capture : definition.captures) {
+            cells.push_back(capture.depth >= 0 ? environment_->at(capture.depth, capture.slot) : (*cells_)[capture.slot]);
+        }
+        return Value::make<Function_Callable>(definition.shared(), std::move(cells));
     }
 
     void visit (const Return_Statement &return_statement) override {
-        Literal::Ptr value;
-        if (return_statement.value) { return_statement.value->accept(*this); } else { value_ = {}; }
-        value = std::move(value_);
-        throw Return(value);
+        if (return_statement.tail_call) {
+            Value callee;
+            Argument_Stack::Frame arguments { arguments_, return_statement.tail_call->arguments.size() + 1 };
+            if (! prepare_call(*return_statement.tail_call, callee, arguments)) { return; }
+            if (defer_call(callee, arguments.values())) { return; }
+            value_ = callee.as<Callable_Literal>().call(*this, arguments.values());
+        } else {
+            evaluate(return_statement.value);
+        }
+        if (unwinding()) { return; }
+        return_value_ = std::move(value_);
+        completion_ = Completion::RETURN;
     }
 
     void interpret(const std::vector<Statement::Ptr> &statements) {
-        environment_ = globals;
-        try {
-            for (const auto &statement : statements) {
-                if (statement) { statement->accept(*this); }
-            }
-        } catch (const Exception &ex) {
-            runtime_error(ex.token, ex.what());
+        environment_ = nullptr;
+        cells_ = nullptr;
+        execute(statements);
+        if (completion_ == Completion::ERROR) {
+            reporter_.runtime_error(error_line_, error_message_);
         }
+        completion_ = Completion::NORMAL;
+        return_value_ = {};
     }
 };
 
-inline void Interpreter::check_number_operand(const Token &token, const Literal::Ptr &right) {
-    if (right && right->is_number()) { return; }
-    throw Exception { token, "Operand must be a number." };
+inline bool Interpreter::check_number_operand(const Node_Token &token, const Value &right) {
+    if (right.is_number()) { return true; }
+    fail(token.line, "Operand must be a number.");
+    return false;
 }
 
-inline void Interpreter::check_number_operands(const Token &token, const Literal::Ptr &left, const Literal::Ptr &right) {
-    if (left && left->is_number() && right && right->is_number()) { return; }
-    throw Exception { token, "Operands must be numbers." };
+inline bool Interpreter::check_number_operands(const Node_Token &token, const Value &left, const Value &right) {
+    if (left.is_number() && right.is_number()) { return true; }
+    fail(token.line, "Operands must be numbers.");
+    return false;
 }
 
-inline Env_Handler::Env_Handler(Interpreter &i): interpreter_ { i }, old_ { interpreter_.environment_} {
-    interpreter_.environment_ = std::make_shared<Environment>(interpreter_.environment_);
-}
 inline Env_Handler::Env_Handler(Interpreter &i, Environment::Ptr new_env): interpreter_ { i }, old_ { interpreter_.environment_ } {
     interpreter_.environment_ = std::move(new_env);
 }
 inline Env_Handler::~Env_Handler() { interpreter_.environment_ = old_; }
+
+template<typename F> void Native_Function<F>::report(Interpreter &interpreter, std::size_t index, const char *type) const {
+    interpreter.fail_call("Argument " + std::to_string(index) + " to '" + name_ + "' must be " + type + ".");
+}
+
+inline Value Lox_Class::call(Interpreter &interpreter, std::span<const Value> arguments) const {
+    Value instance { Value::make<Instance>(Value { this }) };
+    if (init.is_object(Object_Type::CALLABLE)) { interpreter.call_method(init, instance, arguments); }
+    return instance;
+}
+
+inline Value Bound_Method::call(Interpreter &interpreter, std::span<const Value> arguments) const {
+    return interpreter.call_method(method, receiver, arguments);
+}
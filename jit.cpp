@@ -0,0 +1,619 @@
+#include "jit.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <ostream>
+#include <utility>
+
+#include "interpreter.h"
+
+#if defined(__x86_64__) && defined(__unix__)
+#define LOX_JIT 1
+#include <cstring>
+#include <limits>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+static_assert(sizeof(Value) == sizeof(std::uint64_t), "compiled code reads arguments as raw bits");
+
+Jit_Code::Jit_Code(void *memory, std::size_t size):
+    memory_ { memory }, size_ { size }, entry_ { reinterpret_cast<Entry>(memory) }
+{ }
+
+Jit_Code::~Jit_Code() {
+#ifdef LOX_JIT
+    munmap(memory_, size_);
+#endif
+}
+
+Value Jit_Code::run(Interpreter &interpreter, std::span<const Value> arguments) const {
+    Jit_Frame frame { .interpreter = &interpreter };
+    std::uint64_t result { entry_(&frame, arguments.data()) };
+    if (frame.kept_total >= Jit::retire_after) { retired = true; }
+    if (frame.unwinding) { return { }; }
+    return Value::from_bits(result);
+}
+
+std::uint64_t Jit::keep(Jit_Frame &frame, Value value) {
+    std::uint64_t bits { value.bits() };
+    if (! value.is_object()) { return bits; }
+    // the same few objects tend to come back, like a function called in a loop
+    auto &kept { frame.kept };
+    for (std::size_t i = kept.size(); i > 0 && kept.size() - i < 8; --i) {
+        if (kept[i - 1].bits() == bits) { return bits; }
+    }
+    kept.push_back(std::move(value));
+    ++frame.kept_total;
+    if (kept.size() >= frame.sweep_at) { sweep(frame, bits); }
+    return bits;
+}
+
+// Lets go of the kept objects the code no longer has: those that are in
+// none of its local slots or pushed operands, nor the one being returned
+// to it. Slots of scopes that ended and padding are looked at as well,
+// which can only keep more than needed.
+void Jit::sweep(Jit_Frame &frame, std::uint64_t keeping) {
+    std::vector<std::uint64_t> held { frame.stack, frame.base };
+    held.push_back(keeping);
+    std::sort(held.begin(), held.end());
+    auto &kept { frame.kept };
+    std::erase_if(kept, [&held](const Value &value) { return ! std::binary_search(held.begin(), held.end(), value.bits()); });
+    frame.sweep_at = std::max<std::size_t>(64, 2 * kept.size());
+}
+
+std::uint64_t Jit::get_global(Jit_Frame *frame, const Var_Expression *expression) {
+    Interpreter &interpreter { *frame->interpreter };
+    interpreter.visit(*expression);
+    frame->unwinding = interpreter.unwinding();
+    return keep(*frame, std::move(interpreter.value_));
+}
+
+std::uint64_t Jit::set_global(Jit_Frame *frame, const Assign_Expression *expression, std::uint64_t value) {
+    Interpreter &interpreter { *frame->interpreter };
+    interpreter.assign_global(*expression, Value::from_bits(value));
+    frame->unwinding = interpreter.unwinding();
+    return value;
+}
+
+std::uint64_t Jit::binary(Jit_Frame *frame, const Binary_Expression *expression, std::uint64_t left, std::uint64_t right) {
+    Interpreter &interpreter { *frame->interpreter };
+    interpreter.apply(*expression, Value::from_bits(left), Value::from_bits(right));
+    frame->unwinding = interpreter.unwinding();
+    return keep(*frame, std::move(interpreter.value_));
+}
+
+std::uint64_t Jit::unary(Jit_Frame *frame, const Unary *expression, std::uint64_t right) {
+    Interpreter &interpreter { *frame->interpreter };
+    interpreter.apply(*expression, Value::from_bits(right));
+    frame->unwinding = interpreter.unwinding();
+    return keep(*frame, std::move(interpreter.value_));
+}
+
+std::uint64_t Jit::call(Jit_Frame &frame, const std::uint64_t *stack, std::size_t count, const Call_Expression &expression, bool tail) {
+    Interpreter &interpreter { *frame.interpreter };
+    // the callee was pushed first and the last argument last, so they lie
+    // in reverse order
+    Value callee { Value::from_bits(stack[count]) };
+    Argument_Stack::Frame arguments { interpreter.arguments_, count };
+    for (std::size_t i = count; i > 0; --i) { arguments.push(Value::from_bits(stack[i - 1])); }
+    interpreter.call_line_ = expression.paren.line;
+    if (! interpreter.check_call(expression, callee, count) || (tail && interpreter.defer_call(callee, arguments.values()))) {
+        frame.unwinding = true;
+        return Value { }.bits();
+    }
+    Value result { callee.as<Callable_Literal>().call(interpreter, arguments.values()) };
+    frame.unwinding = interpreter.unwinding();
+    return keep(frame, std::move(result));
+}
+
+std::uint64_t Jit::call(Jit_Frame *frame, const std::uint64_t *stack, std::size_t count, const Call_Expression *expression) {
+    return call(*frame, stack, count, *expression, false);
+}
+
+std::uint64_t Jit::tail_call(Jit_Frame *frame, const std::uint64_t *stack, std::size_t count, const Call_Expression *expression) {
+    return call(*frame, stack, count, *expression, true);
+}
+
+void Jit::print(Jit_Frame *frame, std::uint64_t value) {
+    frame->interpreter->out_ << Value::from_bits(value).to_string() << "\n";
+}
+
+#ifdef LOX_JIT
+
+namespace {
+    enum Reg: std::uint8_t { RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI, R8, R9, R10, R11, R12, R13, R14, R15 };
+    enum Xmm: std::uint8_t { XMM0, XMM1 };
+    enum Cond: std::uint8_t {
+        BELOW = 0x2, ABOVE_EQUAL = 0x3, EQUAL = 0x4, NOT_EQUAL = 0x5, ABOVE = 0x7, PARITY = 0xa, NO_PARITY = 0xb
+    };
+
+    // Encodes the few x86-64 instructions the compiler needs. All integer
+    // operations are on 64-bit registers.
+    class Assembler {
+            std::vector<std::uint8_t> code_;
+
+            void rex(int reg, int rm) { byte(0x48 | (reg >> 3) << 2 | rm >> 3); }
+            void modrm(int mod, int reg, int rm) { byte(mod << 6 | (reg & 7) << 3 | (rm & 7)); }
+
+            // [base + disp32]; rsp and r12 as a base need a SIB byte
+            void memory(int reg, Reg base, std::int32_t disp) {
+                modrm(2, reg, base);
+                if ((base & 7) == RSP) { byte(0x24); }
+                dword(static_cast<std::uint32_t>(disp));
+            }
+
+            void alu(std::uint8_t op, Reg dst, Reg src) { rex(src, dst); byte(op); modrm(3, src, dst); }
+            void alu_imm(int ext, Reg dst, std::int32_t imm) {
+                rex(0, dst);
+                byte(0x81);
+                modrm(3, ext, dst);
+                dword(static_cast<std::uint32_t>(imm));
+            }
+
+            void patch(std::size_t at, std::size_t target) {
+                auto offset { static_cast<std::int32_t>(target - (at + 4)) };
+                std::memcpy(&code_[at], &offset, 4);
+            }
+
+        public:
+            class Label {
+                    static constexpr std::size_t unbound { std::numeric_limits<std::size_t>::max() };
+                    std::size_t at_ = unbound;
+                    std::vector<std::size_t> uses_;
+                    friend class Assembler;
+            };
+
+            [[nodiscard]] const std::vector<std::uint8_t> &code() const { return code_; }
+            [[nodiscard]] std::size_t size() const { return code_.size(); }
+
+            void byte(std::uint8_t value) { code_.push_back(value); }
+            void dword(std::uint32_t value) { for (int i = 0; i < 4; ++i) { byte(value >> 8 * i); } }
+            void qword(std::uint64_t value) { for (int i = 0; i < 8; ++i) { byte(value >> 8 * i); } }
+            void patch_dword(std::size_t at, std::uint32_t value) { std::memcpy(&code_[at], &value, 4); }
+
+            void push(Reg reg) { if (reg >= R8) { byte(0x41); } byte(0x50 | (reg & 7)); }
+            void pop(Reg reg) { if (reg >= R8) { byte(0x41); } byte(0x58 | (reg & 7)); }
+            void mov(Reg dst, Reg src) { alu(0x89, dst, src); }
+            void mov(Reg dst, std::uint64_t imm) { rex(0, dst); byte(0xb8 | (dst & 7)); qword(imm); }
+            void load(Reg dst, Reg base, std::int32_t disp) { rex(dst, base); byte(0x8b); memory(dst, base, disp); }
+            void store(Reg base, std::int32_t disp, Reg src) { rex(src, base); byte(0x89); memory(src, base, disp); }
+            void lea(Reg dst, Reg base, std::int32_t disp) { rex(dst, base); byte(0x8d); memory(dst, base, disp); }
+
+            void add(Reg dst, Reg src) { alu(0x01, dst, src); }
+            void sub(Reg dst, Reg src) { alu(0x29, dst, src); }
+            void and_(Reg dst, Reg src) { alu(0x21, dst, src); }
+            void xor_(Reg dst, Reg src) { alu(0x31, dst, src); }
+            void cmp(Reg dst, Reg src) { alu(0x39, dst, src); }
+            void add(Reg dst, std::int32_t imm) { alu_imm(0, dst, imm); }
+            void sub(Reg dst, std::int32_t imm) { alu_imm(5, dst, imm); }
+            void cmp(Reg dst, std::int32_t imm) { alu_imm(7, dst, imm); }
+
+            // cmp byte [base], imm8
+            void cmp_byte(Reg base, std::uint8_t imm) { byte(0x80); modrm(0, 7, base); byte(imm); }
+
+            // the low bytes of rax, rcx, rdx and rbx
+            void setcc(Cond cond, Reg reg) { byte(0x0f); byte(0x90 | cond); modrm(3, 0, reg); }
+            void and8(Reg dst, Reg src) { byte(0x20); modrm(3, src, dst); }
+            void or8(Reg dst, Reg src) { byte(0x08); modrm(3, src, dst); }
+            void movzx8(Reg dst, Reg src) { byte(0x0f); byte(0xb6); modrm(3, dst, src); }
+
+            void movq(Xmm dst, Reg src) { byte(0x66); rex(dst, src); byte(0x0f); byte(0x6e); modrm(3, dst, src); }
+            void movq(Reg dst, Xmm src) { byte(0x66); rex(src, dst); byte(0x0f); byte(0x7e); modrm(3, src, dst); }
+            void addsd(Xmm dst, Xmm src) { sse(0xf2, 0x58, dst, src); }
+            void subsd(Xmm dst, Xmm src) { sse(0xf2, 0x5c, dst, src); }
+            void mulsd(Xmm dst, Xmm src) { sse(0xf2, 0x59, dst, src); }
+            void divsd(Xmm dst, Xmm src) { sse(0xf2, 0x5e, dst, src); }
+            void ucomisd(Xmm a, Xmm b) { sse(0x66, 0x2e, a, b); }
+            void sse(std::uint8_t prefix, std::uint8_t op, Xmm dst, Xmm src) {
+                byte(prefix);
+                byte(0x0f);
+                byte(op);
+                modrm(3, dst, src);
+            }
+
+            void call(Reg reg) { if (reg >= R8) { byte(0x41); } byte(0xff); modrm(3, 2, reg); }
+            void ret() { byte(0xc3); }
+
+            void jmp(Label &label) { byte(0xe9); use(label); }
+            void jcc(Cond cond, Label &label) { byte(0x0f); byte(0x80 | cond); use(label); }
+
+            void use(Label &label) {
+                std::size_t at { code_.size() };
+                dword(0);
+                if (label.at_ != Label::unbound) { patch(at, label.at_); } else { label.uses_.push_back(at); }
+            }
+
+            void bind(Label &label) {
+                label.at_ = code_.size();
+                for (auto at : label.uses_) { patch(at, label.at_); }
+                label.uses_.clear();
+            }
+    };
+}
+
+// Compiles one function body. Values live in registers and in a frame of
+// local slots as raw Value bits: rbx holds the Jit_Frame, r12 the locals,
+// r13 the quiet NaN that tags non-numbers and r14 the bits of nil.
+// Expressions leave their value in rax and keep pending operands on the
+// machine stack. Every environment the interpreter would create for the
+// function gets its own range of slots.
+class Jit_Compiler: public Expression_Visitor, public Statement_Visitor {
+        using Label = Assembler::Label;
+        using Helper = std::uint64_t (*)(Jit_Frame *, const std::uint64_t *, std::size_t, const Call_Expression *);
+
+        static constexpr Reg frame_ { RBX };
+        static constexpr Reg locals_ { R12 };
+        static constexpr Reg nan_ { R13 };
+        static constexpr Reg nil_ { R14 };
+
+        Assembler as_;
+        bool supported_ = true;
+        std::vector<int> scopes_;
+        int next_slot_ = 0;
+        int slots_ = 0;
+        int pushed_ = 0;
+        Label return_nil_;
+        Label exit_;
+
+        // of a helper or of the node a helper is called for
+        static std::uint64_t address(auto pointer) { return reinterpret_cast<std::uintptr_t>(pointer); }
+
+        void push(Reg reg) { as_.push(reg); ++pushed_; }
+        void pop(Reg reg) { as_.pop(reg); --pushed_; }
+
+        // calls a helper with arguments already in rdi, rsi, rdx and rcx,
+        // keeping the stack 16-byte aligned
+        void call(std::uint64_t function) {
+            // where the operands end, for Jit::sweep
+            as_.store(frame_, offsetof(Jit_Frame, stack), RSP);
+            bool pad { pushed_ % 2 != 0 };
+            if (pad) { as_.sub(RSP, 8); }
+            as_.mov(RAX, function);
+            as_.call(RAX);
+            if (pad) { as_.add(RSP, 8); }
+        }
+
+        // leaves the function if the last helper left the interpreter
+        // unwinding
+        void check() {
+            as_.cmp_byte(frame_, 0);
+            as_.jcc(NOT_EQUAL, return_nil_);
+        }
+
+        void jump_unless_number(Reg reg, Label &label) {
+            as_.mov(RDX, reg);
+            as_.and_(RDX, nan_);
+            as_.cmp(RDX, nan_);
+            as_.jcc(EQUAL, label);
+        }
+
+        // sets the flags so that BELOW means rax is falsy: nil and false are
+        // the two tags just above nil
+        void test_falsy() {
+            as_.mov(RCX, RAX);
+            as_.sub(RCX, nil_);
+            as_.cmp(RCX, 2);
+        }
+
+        // turns the 0 or 1 in al into false or true
+        void boolean() {
+            as_.movzx8(RAX, RAX);
+            as_.add(RAX, nil_);
+            as_.add(RAX, 1);
+        }
+
+        int local(int depth, int slot) {
+            if (depth < 0 || depth >= static_cast<int>(scopes_.size())) {
+                supported_ = false;
+                return 0;
+            }
+            return scopes_[scopes_.size() - 1 - depth] + slot;
+        }
+
+        static std::int32_t offset(int slot) { return 8 * slot; }
+
+        void evaluate(const Expression::Ptr &expression) {
+            if (expression) { expression->accept(*this); } else { as_.mov(RAX, nil_); }
+        }
+
+        void execute(const Statement::Ptr &statement) {
+            if (statement) { statement->accept(*this); }
+        }
+
+        void execute(const std::vector<Statement::Ptr> &statements) {
+            for (const auto &statement : statements) { execute(statement); }
+        }
+
+        void open_scope(int size) {
+            scopes_.push_back(next_slot_);
+            next_slot_ += size;
+            slots_ = std::max(slots_, next_slot_);
+        }
+
+    public:
+        bool compile(const Function_Definition &definition) {
+            as_.push(RBP);
+            as_.mov(RBP, RSP);
+            as_.push(RBX);
+            as_.push(R12);
+            as_.push(R13);
+            as_.push(R14);
+            // five pushes on top of the return address leave the stack
+            // aligned; the frame size is patched in once it is known
+            as_.sub(RSP, 0);
+            std::size_t frame_size_at { as_.size() - 4 };
+            as_.mov(locals_, RSP);
+            as_.mov(frame_, RDI);
+            as_.lea(RAX, RBP, -32);
+            as_.store(frame_, offsetof(Jit_Frame, base), RAX);
+            as_.mov(nan_, Value::quiet_nan);
+            as_.mov(nil_, Value::nil_bits);
+            // a method gets the instance first
+            int arguments { static_cast<int>(definition.params.size()) + (definition.is_method() ? 1 : 0) };
+            for (int i = 0; i < arguments; ++i) {
+                as_.load(RAX, RSI, offset(i));
+                as_.store(locals_, offset(i), RAX);
+            }
+
+            open_scope(definition.frame_size);
+            if (definition.body) { execute(definition.body->statements); }
+
+            as_.bind(return_nil_);
+            as_.mov(RAX, nil_);
+            as_.bind(exit_);
+            as_.lea(RSP, RBP, -32);
+            as_.pop(R14);
+            as_.pop(R13);
+            as_.pop(R12);
+            as_.pop(RBX);
+            as_.pop(RBP);
+            as_.ret();
+
+            as_.patch_dword(frame_size_at, offset((slots_ + 1) / 2 * 2));
+            return supported_;
+        }
+
+        [[nodiscard]] const std::vector<std::uint8_t> &code() const { return as_.code(); }
+
+        void visit(const Binary_Expression &binary) override {
+            evaluate(binary.left);
+            push(RAX);
+            evaluate(binary.right);
+            pop(RCX);
+
+            Label slow;
+            Label done;
+            jump_unless_number(RCX, slow);
+            jump_unless_number(RAX, slow);
+            as_.movq(XMM0, RCX);
+            as_.movq(XMM1, RAX);
+            switch (binary.token.type) {
+                case Token_Type::PLUS: as_.addsd(XMM0, XMM1); as_.movq(RAX, XMM0); break;
+                case Token_Type::MINUS: as_.subsd(XMM0, XMM1); as_.movq(RAX, XMM0); break;
+                case Token_Type::STAR: as_.mulsd(XMM0, XMM1); as_.movq(RAX, XMM0); break;
+                case Token_Type::SLASH: as_.divsd(XMM0, XMM1); as_.movq(RAX, XMM0); break;
+                // an unordered comparison sets the carry and zero flags, so
+                // ABOVE and ABOVE_EQUAL are false for NaN
+                case Token_Type::GREATER: as_.ucomisd(XMM0, XMM1); as_.setcc(ABOVE, RAX); boolean(); break;
+                case Token_Type::GREATER_EQUAL: as_.ucomisd(XMM0, XMM1); as_.setcc(ABOVE_EQUAL, RAX); boolean(); break;
+                case Token_Type::LESS: as_.ucomisd(XMM1, XMM0); as_.setcc(ABOVE, RAX); boolean(); break;
+                case Token_Type::LESS_EQUAL: as_.ucomisd(XMM1, XMM0); as_.setcc(ABOVE_EQUAL, RAX); boolean(); break;
+                case Token_Type::EQUAL_EQUAL:
+                    as_.ucomisd(XMM0, XMM1);
+                    as_.setcc(EQUAL, RAX);
+                    as_.setcc(NO_PARITY, RCX);
+                    as_.and8(RAX, RCX);
+                    boolean();
+                    break;
+                case Token_Type::BANG_EQUAL:
+                    as_.ucomisd(XMM0, XMM1);
+                    as_.setcc(NOT_EQUAL, RAX);
+                    as_.setcc(PARITY, RCX);
+                    as_.or8(RAX, RCX);
+                    boolean();
+                    break;
+                default:
+                    supported_ = false;
+                    return;
+            }
+            as_.jmp(done);
+
+            as_.bind(slow);
+            as_.mov(RDI, frame_);
+            as_.mov(RSI, address(&binary));
+            as_.mov(RDX, RCX);
+            as_.mov(RCX, RAX);
+            call(address(&Jit::binary));
+            check();
+            as_.bind(done);
+        }
+
+        void visit(const Grouping &grouping) override { evaluate(grouping.expression); }
+
+        void visit(const Literal &literal) override { as_.mov(RAX, literal.to_value().bits()); }
+
+        void visit(const Unary &unary) override {
+            evaluate(unary.right);
+            if (unary.token.type == Token_Type::BANG) {
+                test_falsy();
+                as_.setcc(BELOW, RAX);
+                boolean();
+                return;
+            }
+            Label slow;
+            Label done;
+            jump_unless_number(RAX, slow);
+            as_.mov(RCX, std::uint64_t { Value::sign_bit });
+            as_.xor_(RAX, RCX);
+            as_.jmp(done);
+            as_.bind(slow);
+            as_.mov(RDI, frame_);
+            as_.mov(RSI, address(&unary));
+            as_.mov(RDX, RAX);
+            call(address(&Jit::unary));
+            check();
+            as_.bind(done);
+        }
+
+        void visit(const Var_Expression &expression) override {
+            if (expression.boxed || expression.upvalue >= 0) {
+                supported_ = false;
+                return;
+            }
+            if (expression.depth >= 0) {
+                as_.load(RAX, locals_, offset(local(expression.depth, expression.slot)));
+                return;
+            }
+            as_.mov(RDI, frame_);
+            as_.mov(RSI, address(&expression));
+            call(address(&Jit::get_global));
+            check();
+        }
+
+        void visit(const Assign_Expression &expression) override {
+            evaluate(expression.value);
+            if (expression.boxed || expression.upvalue >= 0) {
+                supported_ = false;
+                return;
+            }
+            if (expression.depth >= 0) {
+                as_.store(locals_, offset(local(expression.depth, expression.slot)), RAX);
+                return;
+            }
+            as_.mov(RDI, frame_);
+            as_.mov(RSI, address(&expression));
+            as_.mov(RDX, RAX);
+            call(address(&Jit::set_global));
+            check();
+        }
+
+        void visit(const Logical_Expression &expression) override {
+            Label done;
+            evaluate(expression.left);
+            test_falsy();
+            as_.jcc(expression.token.type == Token_Type::OR ? ABOVE_EQUAL : BELOW, done);
+            evaluate(expression.right);
+            as_.bind(done);
+        }
+
+        void call(const Call_Expression &expression, std::uint64_t helper) {
+            evaluate(expression.callee);
+            push(RAX);
+            for (const auto &argument : expression.arguments) {
+                evaluate(argument);
+                push(RAX);
+            }
+            auto count { static_cast<std::int32_t>(expression.arguments.size()) };
+            as_.mov(RDI, frame_);
+            as_.mov(RSI, RSP);
+            as_.mov(RDX, static_cast<std::uint64_t>(count));
+            as_.mov(RCX, address(&expression));
+            call(helper);
+            as_.add(RSP, offset(count + 1));
+            pushed_ -= count + 1;
+            check();
+        }
+
+        void visit(const Call_Expression &expression) override {
+            call(expression, address(static_cast<Helper>(&Jit::call)));
+        }
+
+        void visit(const Print_Statement &statement) override {
+            evaluate(statement.expression);
+            as_.mov(RDI, frame_);
+            as_.mov(RSI, RAX);
+            call(address(&Jit::print));
+        }
+
+        void visit(const Expression_Statement &statement) override { evaluate(statement.expression); }
+
+        void visit(const Var_Statement &statement) override {
+            evaluate(statement.initializer);
+            if (statement.slot < 0) {
+                supported_ = false;
+                return;
+            }
+            as_.store(locals_, offset(scopes_.back() + statement.slot), RAX);
+        }
+
+        void visit(const Block_Statement &statement) override {
+            if (statement.frame_size == 0) {
+                execute(statement.statements);
+                return;
+            }
+            int next_slot { next_slot_ };
+            open_scope(statement.frame_size);
+            execute(statement.statements);
+            scopes_.pop_back();
+            next_slot_ = next_slot;
+        }
+
+        void visit(const If_Statement &statement) override {
+            Label otherwise;
+            Label done;
+            evaluate(statement.condition);
+            test_falsy();
+            as_.jcc(BELOW, otherwise);
+            execute(statement.then_branch);
+            as_.jmp(done);
+            as_.bind(otherwise);
+            execute(statement.else_branch);
+            as_.bind(done);
+        }
+
+        void visit(const While_Statement &statement) override {
+            Label loop;
+            Label done;
+            as_.bind(loop);
+            evaluate(statement.condition);
+            test_falsy();
+            as_.jcc(BELOW, done);
+            execute(statement.body);
+            as_.jmp(loop);
+            as_.bind(done);
+        }
+
+        void visit(const Function_Definition &statement) override { supported_ = false; }
+
+        void visit(const Class_Statement &statement) override { supported_ = false; }
+
+        void visit(const Get_Expression &expression) override { supported_ = false; }
+
+        void visit(const Set_Expression &expression) override { supported_ = false; }
+
+        void visit(const This_Expression &expression) override { visit(static_cast<const Var_Expression &>(expression)); }
+
+        void visit(const Super_Expression &expression) override { supported_ = false; }
+
+        void visit(const Return_Statement &statement) override {
+            if (statement.tail_call) {
+                call(*statement.tail_call, address(&Jit::tail_call));
+            } else {
+                evaluate(statement.value);
+            }
+            as_.jmp(exit_);
+        }
+};
+
+std::unique_ptr<Jit_Code> Jit::compile(const Function_Definition &definition) {
+    Jit_Compiler compiler;
+    if (! compiler.compile(definition)) { return { }; }
+    const auto &code { compiler.code() };
+    auto page { static_cast<std::size_t>(sysconf(_SC_PAGESIZE)) };
+    std::size_t size { (code.size() + page - 1) / page * page };
+    void *memory { mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0) };
+    if (memory == MAP_FAILED) { return { }; }
+    std::memcpy(memory, code.data(), code.size());
+    if (mprotect(memory, size, PROT_READ | PROT_EXEC) != 0) {
+        munmap(memory, size);
+        return { };
+    }
+    return std::make_unique<Jit_Code>(memory, size);
+}
+
+#else
+
+std::unique_ptr<Jit_Code> Jit::compile(const Function_Definition &definition) { return { }; }
+
+#endif
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <vector>
+
+#include "call_expression.h"
+#include "function_definition.h"
+#include "value.h"
+
+class Assign_Expression;
+class Binary_Expression;
+class Interpreter;
+class Unary;
+class Var_Expression;
+
+// State of one run of compiled code. The code keeps values as raw bits, so
+// objects it gets hold of mid-run (call results, globals, concatenations)
+// are kept alive here. Once kept has grown enough, the objects that no
+// local slot or pending operand holds any more are let go, so a loop that
+// replaces a value keeps a bounded number. The run stops early once the
+// interpreter is unwinding: on a runtime error or to leave a tail call.
+struct Jit_Frame {
+    // first, for the code to test
+    bool unwinding = false;
+    Interpreter *interpreter;
+    // the code's part of the machine stack, from the operands it pushed
+    // before the last helper call up to the local slots' end
+    const std::uint64_t *stack = nullptr;
+    const std::uint64_t *base = nullptr;
+    std::vector<Value> kept;
+    // the size of kept that makes keep sweep it, and the objects kept in all
+    std::size_t sweep_at = 64;
+    std::size_t kept_total = 0;
+};
+
+// Native code for one Lox function, in its own executable mapping.
+class Jit_Code {
+    public:
+        using Entry = std::uint64_t (*)(Jit_Frame *frame, const Value *arguments);
+
+    private:
+        void *memory_;
+        std::size_t size_;
+        Entry entry_;
+
+    public:
+        // set after a run that got hold of so many objects that the
+        // interpreter is the better choice for this function; later calls
+        // run in the interpreter
+        mutable bool retired = false;
+
+        Jit_Code(void *memory, std::size_t size);
+        Jit_Code(const Jit_Code &) = delete;
+        Jit_Code &operator=(const Jit_Code &) = delete;
+        ~Jit_Code();
+
+        Value run(Interpreter &interpreter, std::span<const Value> arguments) const;
+};
+
+// A template compiler from function bodies to x86-64 code. Numbers, locals,
+// arithmetic, comparisons and control flow are compiled inline; operations
+// on other types, globals, calls and print call back into the interpreter,
+// so the results and errors are the same. Functions with anything the
+// compiler does not handle keep running in the interpreter.
+class Jit {
+        static constexpr std::size_t retire_after { 4096 };
+
+        static std::uint64_t keep(Jit_Frame &frame, Value value);
+        static void sweep(Jit_Frame &frame, std::uint64_t keeping);
+        static std::uint64_t call(Jit_Frame &frame, const std::uint64_t *stack, std::size_t count, const Call_Expression &expression, bool tail);
+
+        // called from compiled code
+        static std::uint64_t get_global(Jit_Frame *frame, const Var_Expression *expression);
+        static std::uint64_t set_global(Jit_Frame *frame, const Assign_Expression *expression, std::uint64_t value);
+        static std::uint64_t binary(Jit_Frame *frame, const Binary_Expression *expression, std::uint64_t left, std::uint64_t right);
+        static std::uint64_t unary(Jit_Frame *frame, const Unary *expression, std::uint64_t right);
+        static std::uint64_t call(Jit_Frame *frame, const std::uint64_t *stack, std::size_t count, const Call_Expression *expression);
+        static std::uint64_t tail_call(Jit_Frame *frame, const std::uint64_t *stack, std::size_t count, const Call_Expression *expression);
+        static void print(Jit_Frame *frame, std::uint64_t value);
+
+        friend class Jit_Code;
+        friend class Jit_Compiler;
+
+    public:
+        static inline bool enabled = false;
+        // calls a function runs in the interpreter before it is compiled
+        static inline int threshold = 100;
+
+        // null if the function uses something the compiler does not handle
+        // or there is no compiler for this platform
+        static std::unique_ptr<Jit_Code> compile(const Function_Definition &definition);
+};
@@ -0,0 +1,8 @@
+# Runs a script in the interpreter and again with every function compiled
+# on its first call, and fails if the output differs.
+#   cmake -DLOX=<lox binary> -DSCRIPT=<script> -P jit_diff.cmake
+execute_process(COMMAND ${LOX} ${SCRIPT} OUTPUT_VARIABLE expected ERROR_VARIABLE expected)
+execute_process(COMMAND ${LOX} --jit=0 ${SCRIPT} OUTPUT_VARIABLE actual ERROR_VARIABLE actual)
+if(NOT expected STREQUAL actual)
+    message(FATAL_ERROR "--jit output differs for ${SCRIPT}\n-- interpreter\n${expected}\n-- jit\n${actual}")
+endif()
@@ -4,6 +4,9 @@
 #include <string>
 
 #include "expression.h"
+#include "pool.h"
+#include "symbol.h"
+#include "value.h"
 
 class Literal;
 
@@ -16,13 +19,15 @@ class Literal: public Expression, public std::enable_shared_from_this<Literal> {
         void accept(Expression_Visitor &visitor) const override { visitor.visit(*this); }
 
         [[nodiscard]] bool as_bool() const;
-        [[nodiscard]] std::string as_string() const;
+        [[nodiscard]] const std::string &as_string() const;
         [[nodiscard]] double as_number() const;
 
         [[nodiscard]] virtual bool is_bool() const { return false; }
         [[nodiscard]] virtual bool is_string() const { return false; }
         [[nodiscard]] virtual bool is_number() const { return false; }
 
+        [[nodiscard]] virtual Value to_value() const = 0;
+
         static Ptr create();
         static Ptr create(bool value);
         static Ptr create(std::string value);
@@ -32,6 +37,8 @@ class Literal: public Expression, public std::enable_shared_from_this<Literal> {
             return l ? static_cast<std::string>(*l) : "nil";
         }
 
+        static Value to_value(const Ptr &l) { return l ? l->to_value() : Value { }; }
+
         Ptr shared() const { return shared_from_this(); }
 };
 
@@ -41,14 +48,20 @@ class Bool_Literal: public Literal {
         [[nodiscard]] bool is_bool() const override { return true; }
         explicit Bool_Literal(bool v): value { v } { }
         explicit operator std::string() const override { return value ? "true" : "false"; }
+        [[nodiscard]] Value to_value() const override { return Value { value }; }
 };
 
 class String_Literal: public Literal {
+        const Value object_;
+
     public:
-        const std::string value;
         [[nodiscard]] bool is_string() const override { return true; }
-        explicit String_Literal(std::string v): value { std::move(v) } { }
-        explicit operator std::string() const override { return value; }
+        explicit String_Literal(std::string_view v): object_ { Symbol_Table::instance().string_constant(v) } { }
+        // a constant from Symbol_Table::string_constant
+        explicit String_Literal(Value object): object_ { std::move(object) } { }
+        explicit operator std::string() const override { return object_.as_string(); }
+        [[nodiscard]] const std::string &value() const { return object_.as_string(); }
+        [[nodiscard]] Value to_value() const override { return object_; }
 };
 
 class Number_Literal: public Literal {
@@ -57,13 +70,14 @@ class Number_Literal: public Literal {
         [[nodiscard]] bool is_number() const override { return true; }
         explicit Number_Literal(double v): value { v } { }
         explicit operator std::string() const override { return std::to_string(value); }
+        [[nodiscard]] Value to_value() const override { return Value { value }; }
 };
 
 inline bool Literal::as_bool() const { return dynamic_cast<const Bool_Literal &>(*this).value; }
-inline std::string Literal::as_string() const { return dynamic_cast<const String_Literal &>(*this).value; }
+inline const std::string &Literal::as_string() const { return dynamic_cast<const String_Literal &>(*this).value(); }
 inline double Literal::as_number() const { return dynamic_cast<const Number_Literal &>(*this).value; }
 
 inline Literal::Ptr Literal::create() { return {}; }
-inline Literal::Ptr Literal::create(bool value) { return std::make_shared<Bool_Literal>(value); }
-inline Literal::Ptr Literal::create(std::string value) { return std::make_shared<String_Literal>(std::move(value)); }
-inline Literal::Ptr Literal::create(double value) { return std::make_shared<Number_Literal>(value); }
+inline Literal::Ptr Literal::create(bool value) { return std::allocate_shared<Bool_Literal>(Pool_Allocator<Bool_Literal> { }, value); }
+inline Literal::Ptr Literal::create(std::string value) { return std::allocate_shared<String_Literal>(Pool_Allocator<String_Literal> { }, std::move(value)); }
+inline Literal::Ptr Literal::create(double value) { return std::allocate_shared<Number_Literal>(Pool_Allocator<Number_Literal> { }, value); }
@@ -8,11 +8,11 @@
 
 class Logical_Expression: public Expression {
 public:
-    const Token token;
+    const Node_Token token;
     const Expression::Ptr left;
     const Expression::Ptr right;
 
-    Logical_Expression(const Token& t, Expression::Ptr l, Expression::Ptr r):
+    Logical_Expression(const Node_Token &t, Expression::Ptr l, Expression::Ptr r):
             token { t }, left { std::move(l) }, right { std::move(r) }
     { }
 
@@ -0,0 +1,182 @@
+#pragma once
+
+#include <cstddef>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "callable_literal.h"
+#include "gc.h"
+#include "object.h"
+#include "shape.h"
+#include "symbol.h"
+#include "value.h"
+
+// A class: its methods by name, including the ones it inherits, which are
+// copied down from the superclass when it is made. Calling it makes an
+// instance and runs init on it. The methods are Function_Callables in the
+// tree-walker and compiled functions in the VM, which calls classes and
+// bound methods itself.
+class Lox_Class: public Callable_Literal {
+    public:
+        using Methods = std::unordered_map<Symbol, Value>;
+
+        const std::string name;
+        Value superclass;
+        Methods methods;
+        // the initializer, nil if there is none
+        Value init;
+        // where the instances start out
+        Ref<const Shape> shape;
+
+        // the root shape is made by the caller, as nodes must not be made
+        // while another one is being built
+        Lox_Class(std::string n, Value s, Methods m, Ref<const Shape> root):
+            name { std::move(n) }, superclass { std::move(s) }, methods { std::move(m) }, shape { std::move(root) }
+        {
+            if (superclass.is_object(Object_Type::CALLABLE)) {
+                for (const auto &[method, function] : superclass.as<Lox_Class>().methods) {
+                    methods.emplace(method, function);
+                }
+            }
+            if (const Value *found { find(Symbol_Table::instance().intern("init")) }) { init = *found; }
+        }
+
+        [[nodiscard]] const Value *find(Symbol method) const {
+            auto got { methods.find(method) };
+            return got == methods.end() ? nullptr : &got->second;
+        }
+
+        Value call(Interpreter &interpreter, std::span<const Value> arguments) const override;
+
+        [[nodiscard]] int arity() const override {
+            return init.is_object(Object_Type::CALLABLE) ? init.as<Callable_Literal>().arity() : 0;
+        }
+
+        [[nodiscard]] std::size_t size() const override {
+            return sizeof(Lox_Class) + methods.size() * (sizeof(Symbol) + sizeof(Value) + 2 * sizeof(void *));
+        }
+
+        void trace(Gc_Tracer &tracer) const override {
+            superclass.trace(tracer);
+            for (const auto &[method, function] : methods) { function.trace(tracer); }
+            init.trace(tracer);
+            tracer(shape.get());
+        }
+
+        void clear() override {
+            superclass = { };
+            methods.clear();
+            init = { };
+        }
+
+        explicit operator std::string() const override { return name; }
+
+        // whether a value is a class, as opposed to another callable
+        static bool is_class(const Value &value) {
+            return value.is_object(Object_Type::CALLABLE) && dynamic_cast<const Lox_Class *>(value.as_object());
+        }
+};
+
+// An instance: the shape it has and a dense array of field values in the
+// order the shape gives.
+class Instance: public Object {
+    public:
+        Value klass;
+        mutable Ref<const Shape> shape;
+        mutable std::vector<Value> fields;
+
+        explicit Instance(Value k): Object { Object_Type::INSTANCE }, klass { std::move(k) } {
+            shape = klass.as<Lox_Class>().shape;
+        }
+
+        // The field by that name or else the method of the class, null if
+        // there is neither. A site that saw this shape last needs no lookup.
+        const Value *get(Symbol name, Property_Cache &cache, bool &method) const {
+            if (shape.get() != cache.shape.get()) {
+                cache.shape = shape;
+                cache.next = nullptr;
+                cache.offset = shape->offset(name);
+                if (cache.offset >= 0) {
+                    cache.method = nullptr;
+                } else if (const Value *found { klass.as<Lox_Class>().find(name) }) {
+                    cache.method = found;
+                } else {
+                    cache.shape = nullptr;
+                    return nullptr;
+                }
+            }
+            method = cache.offset < 0;
+            return method ? cache.method : &fields[cache.offset];
+        }
+
+        // Sets the field by that name, adding it if there is none yet.
+        void set(Symbol name, Value value, Property_Cache &cache) const {
+            if (shape.get() != cache.shape.get()) {
+                cache.shape = shape;
+                cache.method = nullptr;
+                cache.offset = shape->offset(name);
+                if (cache.offset >= 0) {
+                    cache.next = nullptr;
+                } else {
+                    cache.offset = static_cast<int>(fields.size());
+                    cache.next = shape->with(name);
+                }
+            }
+            if (cache.next) {
+                shape = cache.next;
+                fields.push_back(std::move(value));
+            } else {
+                fields[cache.offset] = std::move(value);
+            }
+        }
+
+        [[nodiscard]] std::size_t size() const override {
+            return sizeof(Instance) + fields.capacity() * sizeof(Value);
+        }
+
+        void trace(Gc_Tracer &tracer) const override {
+            klass.trace(tracer);
+            if (shape) { tracer(shape.get()); }
+            for (const auto &field : fields) { field.trace(tracer); }
+        }
+
+        void clear() override {
+            klass = { };
+            shape = nullptr;
+            fields.clear();
+        }
+
+        explicit operator std::string() const override { return klass.as<Lox_Class>().name + " instance"; }
+};
+
+// A method read off an instance as a value, with the instance to run it on.
+class Bound_Method: public Callable_Literal {
+    public:
+        Value receiver;
+        Value method;
+
+        Bound_Method(Value r, Value m): receiver { std::move(r) }, method { std::move(m) } { }
+
+        Value call(Interpreter &interpreter, std::span<const Value> arguments) const override;
+
+        [[nodiscard]] int arity() const override {
+            return method.is_object(Object_Type::CALLABLE) ? method.as<Callable_Literal>().arity() : 0;
+        }
+
+        [[nodiscard]] std::size_t size() const override { return sizeof(Bound_Method); }
+
+        void trace(Gc_Tracer &tracer) const override {
+            receiver.trace(tracer);
+            method.trace(tracer);
+        }
+
+        void clear() override {
+            receiver = { };
+            method = { };
+        }
+
+        explicit operator std::string() const override { return method.to_string(); }
+};
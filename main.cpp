@@ -1,52 +1,445 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
 #include <fstream>
+#include <iomanip>
 #include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
 #include <utility>
+#include <vector>
 
+#include "ast_cache.h"
+#include "ast_printer.h"
 #include "err.h"
+#include "gc.h"
 #include "interpreter.h"
+#include "jit.h"
+#include "optimizer.h"
 #include "parser.h"
+#include "pool.h"
+#include "profiler.h"
+#include "purity.h"
+#include "resolver.h"
 #include "scanner.h"
+#include "vm.h"
 
-void run(std::string source) {
-    Scanner scanner { std::move(source) };
-    auto tokens { scanner.scan_tokens() };
-    Parser parser { tokens };
-    auto statements { parser.parse() };
-    if (had_error) { return; }
-    static Interpreter interpreter;
-    interpreter.interpret(statements);
+enum class Engine { tree, vm };
+
+static Engine engine = Engine::tree;
+static bool stream = false;
+static bool dump_ast = false;
+static bool show_stats = false;
+static bool stats_json = false;
+static bool show_gc_stats = false;
+static bool use_cache = false;
+
+// The phases of running source and what they made, summed over the runs of
+// a session, for --stats. Streamed scripts are scanned as they are parsed,
+// so their scan time is part of the parse time, as is loading a --cache.
+struct Run_Stats {
+    using Clock = std::chrono::steady_clock;
+
+    Clock::duration scan { };
+    Clock::duration parse { };
+    Clock::duration optimize { };
+    Clock::duration resolve { };
+    Clock::duration execute { };
+    std::size_t tokens = 0;
+    std::size_t nodes = 0;
+    std::size_t literals = 0;
+};
+
+// runs phase, adding the time it takes to total
+template<typename Phase> decltype(auto) timed(Run_Stats::Clock::duration &total, Phase phase) {
+    struct Timer {
+        Run_Stats::Clock::duration &total;
+        Run_Stats::Clock::time_point start { Run_Stats::Clock::now() };
+        ~Timer() { total += Run_Stats::Clock::now() - start; }
+    } timer { total };
+    return phase();
 }
 
-void run_file(const char *path) {
-    std::ifstream in(path);
-    std::string source {
-        std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()
-    };
-    run(source);
-    if (had_error || had_runtime_error) { exit(EXIT_FAILURE); }
+double millis(Run_Stats::Clock::duration duration) {
+    return std::chrono::duration<double, std::milli>(duration).count();
 }
 
-void run_prompt() {
-    std::cout << "> ";
-    std::string line;
-    while (std::getline(std::cin, line)) {
-        run(line);
-        std::cout << "> ";
-        had_error = false;
+// Runs scripts or the prompt with an interpreter of its own: the program
+// prints to out, and errors and statistics go to err. Sessions on
+// different threads share nothing but the options.
+class Session {
+        std::ostream &out_;
+        std::ostream &err_;
+        Reporter reporter_ { err_ };
+        Run_Stats run_stats_;
+        std::unique_ptr<Interpreter> interpreter_;
+        std::unique_ptr<Vm> vm_;
+
+        Interpreter &interpreter() {
+            if (! interpreter_) { interpreter_ = std::make_unique<Interpreter>(reporter_, out_); }
+            return *interpreter_;
+        }
+
+        Vm &vm() {
+            if (! vm_) { vm_ = std::make_unique<Vm>(reporter_, out_); }
+            return *vm_;
+        }
+
+        [[nodiscard]] bool failed() const { return reporter_.had_error || reporter_.had_runtime_error; }
+
+        // --stats=json: everything --stats reports as one JSON object on a line
+        void write_stats_json(std::ostream &out) {
+            const auto &heap { Heap::instance().stats };
+            bool tree { engine == Engine::tree };
+            const auto &stats { interpreter().stats };
+            out << std::fixed << std::setprecision(3)
+                << "{\"scan_ms\": " << millis(run_stats_.scan) << ", \"parse_ms\": " << millis(run_stats_.parse)
+                << ", \"optimize_ms\": " << millis(run_stats_.optimize) << ", \"resolve_ms\": " << millis(run_stats_.resolve)
+                << ", \"execute_ms\": " << millis(run_stats_.execute)
+                << ", \"tokens\": " << run_stats_.tokens << ", \"ast_nodes\": " << run_stats_.nodes
+                << ", \"literals\": " << run_stats_.literals
+                << ", \"objects\": " << heap.allocated_nodes << ", \"peak_objects\": " << heap.peak_nodes
+                << ", \"environments\": " << stats.environments
+                << ", \"calls\": " << (tree ? stats.calls : vm().stats.calls)
+                << ", \"peak_depth\": " << (tree ? stats.peak_depth : vm().stats.peak_depth);
+            if (tree) {
+                out << ", \"global_hits\": " << stats.global_hits << ", \"global_misses\": " << stats.global_misses
+                    << ", \"call_hits\": " << stats.call_hits << ", \"call_misses\": " << stats.call_misses
+                    << ", \"property_hits\": " << stats.property_hits << ", \"property_misses\": " << stats.property_misses
+                    << ", \"jit_compiled\": " << stats.jit_compiled;
+            }
+            out << "}\n";
+        }
+
+        void write_stats(std::ostream &out) {
+            const auto &heap { Heap::instance().stats };
+            bool tree { engine == Engine::tree };
+            const auto &stats { interpreter().stats };
+            out << std::fixed << std::setprecision(3) << "phases: scan " << millis(run_stats_.scan) << " ms, parse "
+                << millis(run_stats_.parse) << " ms, optimize " << millis(run_stats_.optimize) << " ms, resolve "
+                << millis(run_stats_.resolve) << " ms, execute " << millis(run_stats_.execute) << " ms\n";
+            out << "syntax: " << run_stats_.tokens << " tokens, " << run_stats_.nodes << " ast nodes, "
+                << run_stats_.literals << " literals\n";
+            out << "heap: " << heap.allocated_nodes << " objects, " << heap.peak_nodes << " peak live, "
+                << stats.environments << " environments\n";
+            out << "functions: " << (tree ? stats.calls : vm().stats.calls) << " calls, "
+                << (tree ? stats.peak_depth : vm().stats.peak_depth) << " peak depth\n";
+            if (! tree) { return; }
+            out << "global lookups: " << stats.global_hits << " hits, " << stats.global_misses << " misses\n";
+            out << "calls: " << stats.call_hits << " hits, " << stats.call_misses << " misses\n";
+            out << "properties: " << stats.property_hits << " hits, " << stats.property_misses << " misses\n";
+            if (Jit::enabled) { out << "jit: " << stats.jit_compiled << " functions compiled\n"; }
+        }
+
+        void report_stats() {
+            if (Profiler::enabled) {
+                Profiler::instance().report(err_);
+                std::ofstream out { Profiler::output };
+                Profiler::instance().write_collapsed(out);
+                if (! out) { err_ << "Could not write " << Profiler::output << ".\n"; }
+            }
+            if (show_gc_stats) {
+                const auto &heap { Heap::instance() };
+                const auto &gc { heap.stats };
+                err_ << "gc: " << gc.collections << " collections, " << gc.freed_nodes << " nodes and "
+                    << gc.freed_bytes << " bytes freed, " << heap.live_bytes() << " bytes live\n";
+                err_ << "gc pauses: " << std::fixed << std::setprecision(3) << gc.pause_seconds * 1000 << " ms total, "
+                    << gc.max_pause_seconds * 1000 << " ms max\n";
+                if (Pool::enabled) {
+                    const auto &pool { Pool::thread_stats() };
+                    err_ << "pool: " << pool.allocations << " allocations, " << pool.reused << " reused, "
+                        << pool.chunks << " chunks\n";
+                }
+            }
+            if (show_stats) {
+                if (stats_json) { write_stats_json(err_); } else { write_stats(err_); }
+            }
+            if (engine == Engine::tree && Memo_Table::enabled) {
+                for (const auto &[name, memo] : interpreter().stats.memo) {
+                    double rate { 100.0 * memo.hits / std::max<std::size_t>(memo.hits + memo.misses, 1) };
+                    err_ << "memo " << name << ": " << memo.hits << " hits, " << memo.misses << " misses ("
+                        << std::fixed << std::setprecision(1) << rate << "%)\n";
+                }
+            }
+        }
+
+        // the Optimizer makes the nodes it rewrites into in the parser's arena
+        std::vector<Statement::Ptr> optimize(const std::vector<Statement::Ptr> &parsed, Ast_Arena *arena) {
+            Optimizer optimizer { arena };
+            auto statements { timed(run_stats_.optimize, [&] { return optimizer.optimize(parsed); }) };
+            run_stats_.literals += optimizer.literals();
+            return statements;
+        }
+
+        // resolves and runs a program the Optimizer is done with
+        void execute_optimized(const std::vector<Statement::Ptr> &statements) {
+            // both engines take the variables closures capture from the Resolver
+            Resolver resolver { reporter_ };
+            timed(run_stats_.resolve, [&] { resolver.resolve(statements); });
+            if (reporter_.had_error) { return; }
+            timed(run_stats_.execute, [&] {
+                if (engine == Engine::vm) {
+                    vm().interpret(statements);
+                } else {
+                    if (Memo_Table::enabled) {
+                        Purity purity;
+                        purity.analyze(statements);
+                    }
+                    interpreter().interpret(statements);
+                }
+            });
+        }
+
+        void execute(const std::vector<Statement::Ptr> &parsed, Ast_Arena *arena) {
+            auto statements { optimize(parsed, arena) };
+            if (dump_ast) {
+                Ast_Printer printer { out_ };
+                out_ << "-- parsed\n";
+                printer.print(parsed);
+                out_ << "-- optimized\n";
+                printer.print(statements);
+                return;
+            }
+            execute_optimized(statements);
+        }
+
+        // counts what the parser made once it is done with its source
+        void count_syntax(const Scanner &scanner, const Parser &parser) {
+            run_stats_.tokens += scanner.scanned();
+            run_stats_.nodes += parser.nodes();
+            run_stats_.literals += parser.literals();
+        }
+
+        std::vector<Statement::Ptr> parse(Scanner &scanner, Parser &parser) {
+            if (show_stats) {
+                // scans ahead, so that parsing takes its tokens as they are
+                timed(run_stats_.scan, [&scanner] {
+                    for (std::size_t index { 0 }; scanner.token(index).type != Token_Type::END_OF_DATA; ++index) { }
+                });
+            }
+            auto statements { timed(run_stats_.parse, [&parser] { return parser.parse(); }) };
+            count_syntax(scanner, parser);
+            return statements;
+        }
+
+        void run(std::string source) {
+            Scanner scanner { std::move(source), reporter_ };
+            Parser parser { scanner };
+            auto statements { parse(scanner, parser) };
+            if (reporter_.had_error) { return; }
+            execute(statements, parser.arena());
+        }
+
+        // Runs the program from the script's cache if that was written for
+        // this source, and otherwise parses and optimizes it and writes the
+        // cache for later runs.
+        void run_cached(const char *path, std::string source) {
+            Ast_Cache cache { path, source };
+            if (auto loaded { timed(run_stats_.parse, [&cache] { return cache.load(); }) }) {
+                run_stats_.nodes += cache.nodes();
+                run_stats_.literals += cache.literals();
+                execute_optimized(*loaded);
+                return;
+            }
+            Scanner scanner { std::move(source), reporter_ };
+            Parser parser { scanner };
+            auto parsed { parse(scanner, parser) };
+            if (reporter_.had_error) { return; }
+            auto statements { optimize(parsed, parser.arena()) };
+            cache.store(statements);
+            execute_optimized(statements);
+        }
+
+        // Reads, parses and executes the script one top-level declaration
+        // at a time. After a syntax error the rest is only parsed, to report
+        // further errors; a runtime error stops the script.
+        void run_stream(const char *path) {
+            std::ifstream in(path);
+            Scanner scanner { in, reporter_ };
+            Parser parser { scanner };
+            while (! parser.is_at_end()) {
+                std::vector<Statement::Ptr> statements;
+                statements.push_back(timed(run_stats_.parse, [&parser] { return parser.parse_declaration(); }));
+                if (! reporter_.had_error) { execute(statements, parser.arena()); }
+                if (reporter_.had_runtime_error) { break; }
+            }
+            count_syntax(scanner, parser);
+        }
+
+        void run_file(const char *path) {
+            std::ifstream in(path);
+            std::string source;
+            // read in one go where the size is known, as a character at a
+            // time takes longer than loading a cached program
+            if (in.seekg(0, std::ios::end); in) {
+                source.resize(static_cast<std::size_t>(in.tellg()));
+                in.seekg(0);
+                in.read(source.data(), static_cast<std::streamsize>(source.size()));
+            } else {
+                in.clear();
+                source.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+            }
+            // --dump-ast shows the parsed program, which the cache does not keep
+            if (use_cache && ! dump_ast) { run_cached(path, std::move(source)); } else { run(std::move(source)); }
+        }
+
+    public:
+        Session(std::ostream &out, std::ostream &err): out_ { out }, err_ { err } { }
+
+        // Runs a script, streamed with --stream, and reports the statistics
+        // asked for. Returns whether it ran without errors.
+        bool run_script(const char *path) {
+            if (stream) { run_stream(path); } else { run_file(path); }
+            report_stats();
+            return ! failed();
+        }
+
+        void run_prompt(std::istream &in) {
+            out_ << "> ";
+            std::string line;
+            while (std::getline(in, line)) {
+                run(line);
+                out_ << "> ";
+                reporter_.had_error = false;
+            }
+            report_stats();
+        }
+};
+
+// what a script of a --batch printed and how long it took
+struct Batch_Result {
+    std::string out;
+    std::string err;
+    bool ok = false;
+    Run_Stats::Clock::duration time { };
+};
+
+// Runs each script in a session of its own on jobs threads, which take the
+// scripts in turn as they get done with the last. Then writes what each
+// script printed, in the order given and after a line with its name, and
+// the times they took to stderr. Returns whether all of them ran without
+// errors.
+bool run_batch(const std::vector<const char *> &scripts, unsigned jobs) {
+    std::vector<Batch_Result> results(scripts.size());
+    std::atomic<std::size_t> next { 0 };
+    auto work { [&scripts, &results, &next] {
+        for (std::size_t i; (i = next++) < scripts.size();) {
+            auto &result { results[i] };
+            std::ostringstream out;
+            std::ostringstream err;
+            auto start { Run_Stats::Clock::now() };
+            {
+                // the heap and the pools are the thread's, but their counts
+                // are the script's
+                Heap::instance().stats = { };
+                Pool::reset_thread_stats();
+                Session session { out, err };
+                result.ok = session.run_script(scripts[i]);
+            }
+            // frees the cycles the script left, before the thread runs the next
+            Heap::instance().collect();
+            result.time = Run_Stats::Clock::now() - start;
+            result.out = std::move(out).str();
+            result.err = std::move(err).str();
+        }
+    } };
+
+    auto start { Run_Stats::Clock::now() };
+    std::vector<std::thread> threads;
+    for (unsigned i = 1; i < jobs; ++i) { threads.emplace_back(work); }
+    work();
+    for (auto &thread : threads) { thread.join(); }
+    auto wall { Run_Stats::Clock::now() - start };
+
+    for (std::size_t i = 0; i < scripts.size(); ++i) {
+        std::cout << "== " << scripts[i] << "\n" << results[i].out << std::flush;
+        std::cerr << results[i].err << std::flush;
     }
+    std::size_t failed { 0 };
+    Run_Stats::Clock::duration total { };
+    std::cerr << std::fixed << std::setprecision(3);
+    for (std::size_t i = 0; i < scripts.size(); ++i) {
+        const auto &result { results[i] };
+        failed += result.ok ? 0 : 1;
+        total += result.time;
+        std::cerr << "batch: " << std::setw(10) << millis(result.time) << " ms  " << (result.ok ? "ok    " : "FAILED")
+            << "  " << scripts[i] << "\n";
+    }
+    std::cerr << "batch: " << scripts.size() << " scripts, " << failed << " failed, " << jobs << " threads, "
+        << millis(wall) << " ms wall, " << millis(total) << " ms in scripts\n";
+    return failed == 0;
+}
+
+void usage(const char *name) {
+    std::cerr << "Usage: " << name << " [--engine=tree|vm] [--stream] [--cache] [--dump-ast] [--stats[=json]] [--jit[=calls]] [--memoize[=entries]] [--gc-stats] [--gc-stress] [--profile[=file]] [script | --batch [--jobs=n] script...]\n";
+    exit(EXIT_FAILURE);
 }
 
 int main(int argc, const char *argv[]) {
-    switch (argc) {
-        case 2:
-            run_file(argv[1]);
-            break;
-        case 1:
-            run_prompt();
-            break;
-        default:
-            std::cerr << "Usage: " << argv[0] << " [script]\n";
-            exit(EXIT_FAILURE);
+    std::vector<const char *> scripts;
+    bool batch { false };
+    unsigned jobs { std::max(std::thread::hardware_concurrency(), 1u) };
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--engine=tree") == 0) {
+            engine = Engine::tree;
+        } else if (std::strcmp(argv[i], "--engine=vm") == 0) {
+            engine = Engine::vm;
+        } else if (std::strcmp(argv[i], "--stream") == 0) {
+            stream = true;
+        } else if (std::strcmp(argv[i], "--cache") == 0) {
+            use_cache = true;
+        } else if (std::strcmp(argv[i], "--dump-ast") == 0) {
+            dump_ast = true;
+        } else if (std::strcmp(argv[i], "--stats") == 0) {
+            show_stats = true;
+        } else if (std::strcmp(argv[i], "--stats=json") == 0) {
+            show_stats = true;
+            stats_json = true;
+        } else if (std::strcmp(argv[i], "--jit") == 0) {
+            Jit::enabled = true;
+        } else if (std::strncmp(argv[i], "--jit=", 6) == 0) {
+            Jit::enabled = true;
+            Jit::threshold = std::atoi(argv[i] + 6);
+        } else if (std::strcmp(argv[i], "--gc-stats") == 0) {
+            show_gc_stats = true;
+        } else if (std::strcmp(argv[i], "--gc-stress") == 0) {
+            Heap::stress = true;
+        } else if (std::strcmp(argv[i], "--profile") == 0) {
+            Profiler::enabled = true;
+        } else if (std::strncmp(argv[i], "--profile=", 10) == 0) {
+            Profiler::enabled = true;
+            Profiler::output = argv[i] + 10;
+        } else if (std::strcmp(argv[i], "--memoize") == 0) {
+            Memo_Table::enabled = true;
+        } else if (std::strncmp(argv[i], "--memoize=", 10) == 0) {
+            Memo_Table::enabled = true;
+            Memo_Table::capacity = std::strtoul(argv[i] + 10, nullptr, 10);
+        } else if (std::strcmp(argv[i], "--batch") == 0) {
+            batch = true;
+        } else if (std::strncmp(argv[i], "--jobs=", 7) == 0) {
+            jobs = static_cast<unsigned>(std::max(std::atoi(argv[i] + 7), 1));
+        } else if (argv[i][0] == '-') {
+            usage(argv[0]);
+        } else {
+            scripts.push_back(argv[i]);
+        }
+    }
+    if (batch) {
+        // every script would write the same collapsed stacks file
+        if (scripts.empty() || Profiler::enabled) { usage(argv[0]); }
+        jobs = std::min<unsigned>(jobs, scripts.size());
+        return run_batch(scripts, jobs) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    if (scripts.size() > 1) { usage(argv[0]); }
+    Session session { std::cout, std::cerr };
+    if (scripts.empty()) {
+        session.run_prompt(std::cin);
+        return EXIT_SUCCESS;
     }
-    return EXIT_SUCCESS;
+    return session.run_script(scripts.front()) ? EXIT_SUCCESS : EXIT_FAILURE;
 }
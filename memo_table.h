@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "value.h"
+
+// Results of one pure function by argument values, for --memoize. Holds at
+// most capacity entries and drops the least recently used one when full.
+// The arguments are kept once, in the entry; the index refers to them.
+// Strings match by content and every other value by its bits, so -0 and 0
+// are different arguments while NaN matches itself.
+class Memo_Table {
+        struct Hash {
+            std::size_t operator()(std::span<const Value> arguments) const {
+                std::size_t hash { arguments.size() };
+                for (const auto &argument : arguments) {
+                    std::size_t part {
+                        argument.is_string() ? std::hash<std::string> { }(argument.as_string())
+                            : std::hash<std::uint64_t> { }(argument.bits())
+                    };
+                    hash = hash * 31 + part;
+                }
+                return hash;
+            }
+        };
+
+        struct Equal {
+            bool operator()(std::span<const Value> a, std::span<const Value> b) const {
+                if (a.size() != b.size()) { return false; }
+                for (std::size_t i = 0; i < a.size(); ++i) {
+                    if (a[i].bits() == b[i].bits()) { continue; }
+                    if (! a[i].is_string() || ! b[i].is_string() || a[i].as_string() != b[i].as_string()) {
+                        return false;
+                    }
+                }
+                return true;
+            }
+        };
+
+        using Entries = std::list<std::pair<std::vector<Value>, Value>>;
+
+        // most recently used first
+        Entries entries_;
+        // by the arguments of the entry it points to
+        std::unordered_map<std::span<const Value>, Entries::iterator, Hash, Equal> index_;
+
+    public:
+        struct Stats {
+            std::size_t hits = 0;
+            std::size_t misses = 0;
+        };
+
+        static inline bool enabled = false;
+        static inline std::size_t capacity = 1024;
+
+        // the cached result, or null
+        const Value *find(std::span<const Value> arguments) {
+            auto got { index_.find(arguments) };
+            if (got == index_.end()) { return nullptr; }
+            entries_.splice(entries_.begin(), entries_, got->second);
+            return &got->second->second;
+        }
+
+        void insert(std::span<const Value> arguments, Value result) {
+            if (capacity == 0 || index_.contains(arguments)) { return; }
+            if (entries_.size() >= capacity) {
+                index_.erase(std::span<const Value> { entries_.back().first });
+                entries_.pop_back();
+            }
+            entries_.emplace_front(std::vector<Value> { arguments.begin(), arguments.end() }, std::move(result));
+            index_.emplace(std::span<const Value> { entries_.front().first }, entries_.begin());
+        }
+
+        void clear() {
+            index_.clear();
+            entries_.clear();
+        }
+
+        // every value the table holds
+        void trace(Gc_Tracer &tracer) const {
+            for (const auto &[arguments, result] : entries_) {
+                for (const auto &argument : arguments) { argument.trace(tracer); }
+                result.trace(tracer);
+            }
+        }
+};
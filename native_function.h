@@ -0,0 +1,124 @@
+#pragma once
+
+#include <cstddef>
+#include <span>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "callable_literal.h"
+#include "profiler.h"
+#include "value.h"
+
+// How a C++ type of a native's parameters or result maps to a Value: which
+// values it accepts, what they are called in errors, and the conversions.
+template<typename T> struct Native_Type;
+
+template<> struct Native_Type<double> {
+    static constexpr const char *name { "a number" };
+    static bool accepts(const Value &value) { return value.is_number(); }
+    static double from(const Value &value) { return value.as_number(); }
+    static Value to(double value) { return Value { value }; }
+};
+
+template<> struct Native_Type<bool> {
+    static constexpr const char *name { "a boolean" };
+    static bool accepts(const Value &value) { return value.is_bool(); }
+    static bool from(const Value &value) { return value.as_bool(); }
+    static Value to(bool value) { return Value { value }; }
+};
+
+template<> struct Native_Type<std::string_view> {
+    static constexpr const char *name { "a string" };
+    static bool accepts(const Value &value) { return value.is_string(); }
+    static std::string_view from(const Value &value) { return value.as_string(); }
+};
+
+template<> struct Native_Type<std::string> {
+    static constexpr const char *name { "a string" };
+    static bool accepts(const Value &value) { return value.is_string(); }
+    static const std::string &from(const Value &value) { return value.as_string(); }
+    static Value to(std::string value) { return Value::make<String_Object>(std::move(value)); }
+};
+
+template<> struct Native_Type<Value> {
+    static constexpr const char *name { "a value" };
+    static bool accepts(const Value &value) { return true; }
+    static const Value &from(const Value &value) { return value; }
+    static Value to(Value value) { return value; }
+};
+
+// The result and parameter types of a lambda or function pointer.
+template<typename F> struct Native_Signature: Native_Signature<decltype(&F::operator())> { };
+
+template<typename R, typename... A> struct Native_Signature<R (*)(A...)> {
+    using Result = std::decay_t<R>;
+    using Parameters = std::tuple<std::decay_t<A>...>;
+};
+
+template<typename C, typename R, typename... A> struct Native_Signature<R (C::*)(A...) const>:
+    Native_Signature<R (*)(A...)> { };
+
+template<typename C, typename R, typename... A> struct Native_Signature<R (C::*)(A...)>:
+    Native_Signature<R (*)(A...)> { };
+
+// A native function made from any C++ callable. The arity and the argument
+// checks and conversions follow from its signature, so a native is written
+// like `[](double x) { return std::sqrt(x); }` and needs no code to unbox
+// its arguments. A wrong type fails the call with a runtime error.
+template<typename F> class Native_Function: public Callable_Literal {
+        using Signature = Native_Signature<F>;
+        using Result = typename Signature::Result;
+        using Parameters = typename Signature::Parameters;
+        static constexpr std::size_t count { std::tuple_size_v<Parameters> };
+
+        const std::string name_;
+        F function_;
+
+        template<std::size_t... I>
+        Value call(Interpreter &interpreter, std::span<const Value> arguments, std::index_sequence<I...>) const {
+            // the 1-based index of the first argument of the wrong type
+            std::size_t wrong { 0 };
+            bool accepted {
+                ((Native_Type<std::tuple_element_t<I, Parameters>>::accepts(arguments[I]) || (wrong = I + 1, false)) && ...)
+            };
+            if (! accepted) {
+                report(interpreter, wrong, wrong_type<I...>(wrong - 1));
+                return { };
+            }
+            if constexpr (std::is_void_v<Result>) {
+                function_(Native_Type<std::tuple_element_t<I, Parameters>>::from(arguments[I])...);
+                return { };
+            } else {
+                return Native_Type<Result>::to(
+                    function_(Native_Type<std::tuple_element_t<I, Parameters>>::from(arguments[I])...)
+                );
+            }
+        }
+
+        template<std::size_t... I> static const char *wrong_type(std::size_t index) {
+            const char *names[] { Native_Type<std::tuple_element_t<I, Parameters>>::name..., nullptr };
+            return names[index];
+        }
+
+        void report(Interpreter &interpreter, std::size_t index, const char *type) const;
+
+    public:
+        Native_Function(std::string name, F function): name_ { std::move(name) }, function_ { std::move(function) } { }
+
+        Value call(Interpreter &interpreter, std::span<const Value> arguments) const override {
+            if (Profiler::enabled) {
+                Profiler::instance().enter(this, [this] { return Profiler::Label { name_ }; });
+                Value result { call(interpreter, arguments, std::make_index_sequence<count> { }) };
+                Profiler::instance().leave();
+                return result;
+            }
+            return call(interpreter, arguments, std::make_index_sequence<count> { });
+        }
+
+        [[nodiscard]] int arity() const override { return static_cast<int>(count); }
+
+        [[nodiscard]] std::size_t size() const override { return sizeof(Native_Function); }
+};
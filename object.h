@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <utility>
+
+#include "gc.h"
+
+enum class Object_Type { STRING, CALLABLE, COMPILED_FUNCTION, CLOSURE, CELL, INSTANCE };
+
+class Object: public Gc_Node {
+    public:
+        const Object_Type type;
+
+        explicit Object(Object_Type t): type { t } { }
+
+        [[nodiscard]] std::size_t size() const override { return sizeof(Object); }
+
+        virtual explicit operator std::string() const = 0;
+};
+
+class String_Object: public Object {
+    public:
+        const std::string value;
+        // interned strings are unique per content, so identity decides equality
+        const bool interned;
+
+        explicit String_Object(std::string v, bool i = false):
+            Object { Object_Type::STRING }, value { std::move(v) }, interned { i }
+        { }
+
+        [[nodiscard]] std::size_t size() const override { return sizeof(String_Object) + value.capacity(); }
+
+        explicit operator std::string() const override { return value; }
+};
@@ -0,0 +1,342 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "assign_expression.h"
+#include "ast_arena.h"
+#include "binary_expression.h"
+#include "block_statement.h"
+#include "call_expression.h"
+#include "class_statement.h"
+#include "expression.h"
+#include "expression_statement.h"
+#include "function_definition.h"
+#include "get_expression.h"
+#include "grouping.h"
+#include "if_statement.h"
+#include "literal.h"
+#include "logical_expression.h"
+#include "print_statement.h"
+#include "resolver.h"
+#include "return_statement.h"
+#include "set_expression.h"
+#include "statement.h"
+#include "super_expression.h"
+#include "this_expression.h"
+#include "token.h"
+#include "unary.h"
+#include "value.h"
+#include "var_expression.h"
+#include "var_statement.h"
+#include "while_statement.h"
+
+// Rewrites a parsed program into an equivalent, smaller one before it is
+// resolved: constant subexpressions are folded, branches and loops with
+// constant conditions are pruned, statements after a return are dropped and
+// blocks that declare nothing are merged into the enclosing statement list.
+// Unchanged nodes are shared with the input; new ones are made in the arena
+// of the parse, as the parser makes its own. Operations that would fail at
+// runtime are never folded, so their errors are still reported when (and
+// if) they run.
+class Optimizer: public Expression_Visitor, public Statement_Visitor {
+        // a visitor that rewrites its node stores the replacement here;
+        // otherwise optimize() keeps the original
+        Expression::Ptr expression_;
+        bool expression_replaced_ = false;
+        Statement::Ptr statement_;
+        bool statement_replaced_ = false;
+        std::size_t literals_ = 0;
+        Ast_Arena *arena_;
+
+        template<typename T, typename... Args> std::shared_ptr<T> make(Args &&... args) {
+            return std::allocate_shared<T>(Arena_Allocator<T> { arena_ }, std::forward<Args>(args)...);
+        }
+
+        void replace(Expression::Ptr expression) {
+            expression_ = std::move(expression);
+            expression_replaced_ = true;
+        }
+
+        void replace(Statement::Ptr statement) {
+            statement_ = std::move(statement);
+            statement_replaced_ = true;
+        }
+
+        // nil literals are null pointers
+        static bool is_constant(const Expression::Ptr &expression) {
+            return ! expression || dynamic_cast<const Literal *>(expression.get());
+        }
+
+        static Value constant(const Expression::Ptr &expression) {
+            auto literal { dynamic_cast<const Literal *>(expression.get()) };
+            return literal ? literal->to_value() : Value { };
+        }
+
+        Expression::Ptr literal(const Value &value) {
+            if (! value.is_bool() && ! value.is_number() && ! value.is_string()) { return Literal::create(); }
+            ++literals_;
+            if (value.is_bool()) { return make<Bool_Literal>(value.as_bool()); }
+            if (value.is_number()) { return make<Number_Literal>(value.as_number()); }
+            return make<String_Literal>(value.as_string());
+        }
+
+        // Folds a binary operation on constants. Returns false if the
+        // operation would fail at runtime.
+        static bool fold(Token_Type type, const Value &left, const Value &right, Value &result) {
+            bool numbers { left.is_number() && right.is_number() };
+            switch (type) {
+                case Token_Type::EQUAL_EQUAL: result = Value { left == right }; return true;
+                case Token_Type::BANG_EQUAL: result = Value { left != right }; return true;
+                case Token_Type::PLUS:
+                    if (left.is_string() && right.is_string()) {
+                        result = Value::make<String_Object>(left.as_string() + right.as_string());
+                        return true;
+                    }
+                    break;
+                default: break;
+            }
+            if (! numbers) { return false; }
+            double a { left.as_number() };
+            double b { right.as_number() };
+            switch (type) {
+                case Token_Type::GREATER: result = Value { a > b }; return true;
+                case Token_Type::GREATER_EQUAL: result = Value { a >= b }; return true;
+                case Token_Type::LESS: result = Value { a < b }; return true;
+                case Token_Type::LESS_EQUAL: result = Value { a <= b }; return true;
+                case Token_Type::PLUS: result = Value { a + b }; return true;
+                case Token_Type::MINUS: result = Value { a - b }; return true;
+                case Token_Type::STAR: result = Value { a * b }; return true;
+                case Token_Type::SLASH: result = Value { a / b }; return true;
+                default: return false;
+            }
+        }
+
+        // A block that declares nothing in a single-statement position can
+        // be replaced by its only statement, or by nothing.
+        static Statement::Ptr unwrap(Statement::Ptr statement) {
+            auto block { dynamic_cast<const Block_Statement *>(statement.get()) };
+            if (! block || Resolver::declares(block->statements)) { return statement; }
+            if (block->statements.empty()) { return { }; }
+            if (block->statements.size() == 1) { return block->statements.front(); }
+            return statement;
+        }
+
+    public:
+        explicit Optimizer(Ast_Arena *arena): arena_ { arena } { arena_->retain(); }
+
+        Optimizer(const Optimizer &) = delete;
+        Optimizer &operator=(const Optimizer &) = delete;
+        ~Optimizer() { arena_->release(); }
+
+        // literals made by folding, for --stats
+        [[nodiscard]] std::size_t literals() const { return literals_; }
+
+        Expression::Ptr optimize(const Expression::Ptr &expression) {
+            if (! expression) { return { }; }
+            expression->accept(*this);
+            if (! expression_replaced_) { return expression; }
+            expression_replaced_ = false;
+            return std::move(expression_);
+        }
+
+        Statement::Ptr optimize(const Statement::Ptr &statement) {
+            if (! statement) { return { }; }
+            statement->accept(*this);
+            if (! statement_replaced_) { return statement; }
+            statement_replaced_ = false;
+            return std::move(statement_);
+        }
+
+        std::vector<Statement::Ptr> optimize(const std::vector<Statement::Ptr> &statements) {
+            std::vector<Statement::Ptr> result;
+            for (const auto &statement : statements) {
+                Statement::Ptr optimized { optimize(statement) };
+                if (! optimized) { continue; }
+                auto block { dynamic_cast<const Block_Statement *>(optimized.get()) };
+                if (block && ! Resolver::declares(block->statements)) {
+                    result.insert(result.end(), block->statements.begin(), block->statements.end());
+                } else {
+                    result.push_back(std::move(optimized));
+                }
+                if (! result.empty() && dynamic_cast<const Return_Statement *>(result.back().get())) { break; }
+            }
+            return result;
+        }
+
+        void visit(const Binary_Expression &binary) override {
+            Expression::Ptr left { optimize(binary.left) };
+            Expression::Ptr right { optimize(binary.right) };
+            Value result;
+            if (is_constant(left) && is_constant(right) &&
+                fold(binary.token.type, constant(left), constant(right), result)
+            ) {
+                replace(literal(result));
+            } else if (left != binary.left || right != binary.right) {
+                replace(make<Binary_Expression>(binary.token, std::move(left), std::move(right)));
+            }
+        }
+
+        void visit(const Grouping &grouping) override { replace(optimize(grouping.expression)); }
+
+        void visit(const Literal &literal) override { }
+
+        void visit(const Unary &unary) override {
+            Expression::Ptr right { optimize(unary.right) };
+            if (is_constant(right)) {
+                Value value { constant(right) };
+                if (unary.token.type == Token_Type::BANG) {
+                    replace(literal(Value { ! value.is_truthy() }));
+                    return;
+                }
+                if (unary.token.type == Token_Type::MINUS && value.is_number()) {
+                    replace(literal(Value { -value.as_number() }));
+                    return;
+                }
+            }
+            if (right != unary.right) { replace(make<Unary>(unary.token, std::move(right))); }
+        }
+
+        void visit(const Var_Expression &expression) override { }
+
+        void visit(const Assign_Expression &expression) override {
+            Expression::Ptr value { optimize(expression.value) };
+            if (value != expression.value) {
+                replace(make<Assign_Expression>(expression.name, std::move(value)));
+            }
+        }
+
+        void visit(const Logical_Expression &expression) override {
+            Expression::Ptr left { optimize(expression.left) };
+            Expression::Ptr right { optimize(expression.right) };
+            if (is_constant(left)) {
+                bool truthy { constant(left).is_truthy() };
+                bool short_circuit { expression.token.type == Token_Type::OR ? truthy : ! truthy };
+                replace(short_circuit ? std::move(left) : std::move(right));
+            } else if (left != expression.left || right != expression.right) {
+                replace(make<Logical_Expression>(expression.token, std::move(left), std::move(right)));
+            }
+        }
+
+        void visit(const Call_Expression &expression) override {
+            Expression::Ptr callee { optimize(expression.callee) };
+            bool changed { callee != expression.callee };
+            std::vector<Expression::Ptr> arguments;
+            for (const auto &argument : expression.arguments) {
+                arguments.push_back(optimize(argument));
+                changed = changed || arguments.back() != argument;
+            }
+            if (changed) {
+                replace(make<Call_Expression>(std::move(callee), expression.paren, std::move(arguments)));
+            }
+        }
+
+        void visit(const Print_Statement &statement) override {
+            Expression::Ptr expression { optimize(statement.expression) };
+            if (expression != statement.expression) {
+                replace(make<Print_Statement>(std::move(expression)));
+            }
+        }
+
+        void visit(const Expression_Statement &statement) override {
+            Expression::Ptr expression { optimize(statement.expression) };
+            if (is_constant(expression)) {
+                replace(Statement::Ptr { });
+            } else if (expression != statement.expression) {
+                replace(make<Expression_Statement>(std::move(expression)));
+            }
+        }
+
+        void visit(const Var_Statement &statement) override {
+            Expression::Ptr initializer { optimize(statement.initializer) };
+            if (initializer != statement.initializer) {
+                replace(make<Var_Statement>(statement.name, std::move(initializer)));
+            }
+        }
+
+        void visit(const Block_Statement &statement) override {
+            std::vector<Statement::Ptr> statements { optimize(statement.statements) };
+            if (statements != statement.statements) {
+                replace(make<Block_Statement>(std::move(statements)));
+            }
+        }
+
+        void visit(const If_Statement &statement) override {
+            Expression::Ptr condition { optimize(statement.condition) };
+            if (is_constant(condition)) {
+                replace(unwrap(optimize(constant(condition).is_truthy() ? statement.then_branch : statement.else_branch)));
+                return;
+            }
+            Statement::Ptr then_branch { unwrap(optimize(statement.then_branch)) };
+            Statement::Ptr else_branch { unwrap(optimize(statement.else_branch)) };
+            if (condition != statement.condition || then_branch != statement.then_branch ||
+                else_branch != statement.else_branch
+            ) {
+                replace(make<If_Statement>(std::move(condition), std::move(then_branch), std::move(else_branch)));
+            }
+        }
+
+        void visit(const While_Statement &statement) override {
+            Expression::Ptr condition { optimize(statement.condition) };
+            if (is_constant(condition) && ! constant(condition).is_truthy()) {
+                replace(Statement::Ptr { });
+                return;
+            }
+            Statement::Ptr body { unwrap(optimize(statement.body)) };
+            if (condition != statement.condition || body != statement.body) {
+                replace(make<While_Statement>(std::move(condition), std::move(body)));
+            }
+        }
+
+        void visit(const Function_Definition &statement) override {
+            if (! statement.body) { return; }
+            std::vector<Statement::Ptr> statements { optimize(statement.body->statements) };
+            if (statements != statement.body->statements) {
+                replace(make<Function_Definition>(
+                    statement.name, std::vector<Identifier> { statement.params },
+                    make<Block_Statement>(std::move(statements)), statement.kind
+                ));
+            }
+        }
+
+        void visit(const Return_Statement &statement) override {
+            Expression::Ptr value { optimize(statement.value) };
+            if (value != statement.value) {
+                replace(make<Return_Statement>(statement.keyword, std::move(value)));
+            }
+        }
+
+        void visit(const Get_Expression &expression) override {
+            Expression::Ptr object { optimize(expression.object) };
+            if (object != expression.object) {
+                replace(make<Get_Expression>(std::move(object), expression.name));
+            }
+        }
+
+        void visit(const Set_Expression &expression) override {
+            Expression::Ptr object { optimize(expression.object) };
+            Expression::Ptr value { optimize(expression.value) };
+            if (object != expression.object || value != expression.value) {
+                replace(make<Set_Expression>(std::move(object), expression.name, std::move(value)));
+            }
+        }
+
+        void visit(const This_Expression &expression) override { }
+
+        void visit(const Super_Expression &expression) override { }
+
+        void visit(const Class_Statement &statement) override {
+            bool changed { false };
+            std::vector<Function_Definition::Ptr> methods;
+            for (const auto &method : statement.methods) {
+                Statement::Ptr optimized { optimize(method) };
+                changed = changed || optimized != method;
+                methods.push_back(std::static_pointer_cast<const Function_Definition>(std::move(optimized)));
+            }
+            if (changed) {
+                replace(make<Class_Statement>(statement.name, statement.superclass, std::move(methods)));
+            }
+        }
+};
@@ -1,23 +1,36 @@
 #pragma once
 
+#include <charconv>
+#include <memory>
 #include <stdexcept>
+#include <string_view>
+#include <type_traits>
 #include <utility>
 #include <vector>
 
 #include "assign_expression.h"
+#include "ast_arena.h"
 #include "binary_expression.h"
 #include "block_statement.h"
 #include "call_expression.h"
+#include "class_statement.h"
 #include "err.h"
 #include "function_definition.h"
+#include "get_expression.h"
 #include "grouping.h"
 #include "if_statement.h"
+#include "literal.h"
 #include "logical_expression.h"
 #include "statement.h"
+#include "identifier.h"
 #include "token.h"
 #include "unary.h"
 #include "print_statement.h"
 #include "return_statement.h"
+#include "scanner.h"
+#include "set_expression.h"
+#include "super_expression.h"
+#include "this_expression.h"
 #include "expression_statement.h"
 #include "var_expression.h"
 #include "var_statement.h"
@@ -29,8 +42,17 @@ class Parser {
                 Exception(): std::domain_error { "parse exception" } { }
         };
 
-        const std::vector<Token> tokens_;
-        int current_ = 0;
+        Scanner &scanner_;
+        std::size_t current_ = 0;
+        Ast_Arena *arena_ { Ast_Arena::create() };
+        std::size_t nodes_ = 0;
+        std::size_t literals_ = 0;
+
+        template<typename T, typename... Args> std::shared_ptr<T> make(Args &&... args) {
+            ++nodes_;
+            if constexpr (std::is_base_of_v<Literal, T>) { ++literals_; }
+            return std::allocate_shared<T>(Arena_Allocator<T> { arena_ }, std::forward<Args>(args)...);
+        }
 
         Expression::Ptr expression() {
             return assignment();
@@ -40,18 +62,16 @@ class Parser {
             return false;
         }
 
-        [[nodiscard]] const Token &peek() const { return tokens_[current_]; }
+        [[nodiscard]] const Token &peek() const { return scanner_.token(current_); }
 
-        [[nodiscard]] const Token &previous() const { return tokens_[current_ - 1]; }
-
-        [[nodiscard]] bool is_at_end() const { return peek().type == Token_Type::END_OF_DATA; }
+        [[nodiscard]] const Token &previous() const { return scanner_.token(current_ - 1); }
 
         [[nodiscard]] bool check(const Token_Type &type) const {
             if (is_at_end()) { return false; }
             return peek().type == type;
         }
 
-        Token advance() {
+        const Token &advance() {
             if (! is_at_end()) { ++current_; }
             return previous();
         }
@@ -67,9 +87,9 @@ class Parser {
         Expression::Ptr and_expression() {
             Expression::Ptr expr = equality();
             while (match(Token_Type::AND)) {
-                Token op = previous();
+                const Token &op = previous();
                 Expression::Ptr right = equality();
-                expr = std::make_shared<Logical_Expression>(op, std::move(expr), std::move(right));
+                expr = make<Logical_Expression>(op, std::move(expr), std::move(right));
             }
             return expr;
         }
@@ -77,9 +97,9 @@ class Parser {
         Expression::Ptr or_expression() {
             Expression::Ptr expr = and_expression();
             while (match(Token_Type::OR)) {
-                Token op = previous();
+                const Token &op = previous();
                 Expression::Ptr right = and_expression();
-                expr = std::make_shared<Logical_Expression>(op, std::move(expr), std::move(right));
+                expr = make<Logical_Expression>(op, std::move(expr), std::move(right));
             }
             return expr;
         }
@@ -88,11 +108,14 @@ class Parser {
             Expression::Ptr expr = or_expression();
 
             if (match(Token_Type::EQUAL)) {
-                Token equals = previous();
+                const Token &equals = previous();
                 Expression::Ptr value = assignment();
                 auto v { dynamic_cast<const Var_Expression *>(expr.get()) };
-                if (v) {
-                    return std::make_shared<Assign_Expression>(v->name, std::move(value));
+                if (v && ! dynamic_cast<const This_Expression *>(v)) {
+                    return make<Assign_Expression>(v->name, std::move(value));
+                }
+                if (auto get { dynamic_cast<const Get_Expression *>(expr.get()) }) {
+                    return make<Set_Expression>(get->object, get->name, std::move(value));
                 }
                 error(equals, "Invalid assignment target.");
             }
@@ -103,9 +126,9 @@ class Parser {
         Expression::Ptr equality() {
             Expression::Ptr expr = comparison();
             while (match(Token_Type::BANG_EQUAL, Token_Type::EQUAL_EQUAL)) {
-                Token op = previous();
+                const Token &op = previous();
                 Expression::Ptr right = comparison();
-                expr = std::make_shared<Binary_Expression>(op, std::move(expr), std::move(right));
+                expr = make<Binary_Expression>(op, std::move(expr), std::move(right));
             }
             return expr;
         }
@@ -113,9 +136,9 @@ class Parser {
         Expression::Ptr comparison() {
             Expression::Ptr expr = term();
             while (match(Token_Type::GREATER, Token_Type::GREATER_EQUAL, Token_Type::LESS, Token_Type::LESS_EQUAL)) {
-                Token op = previous();
+                const Token &op = previous();
                 Expression::Ptr right = term();
-                expr = std::make_shared<Binary_Expression>(op, std::move(expr), std::move(right));
+                expr = make<Binary_Expression>(op, std::move(expr), std::move(right));
             }
             return expr;
         }
@@ -123,9 +146,9 @@ class Parser {
         Expression::Ptr term() {
             Expression::Ptr expr = factor();
             while (match(Token_Type::PLUS, Token_Type::MINUS)) {
-                Token op = previous();
+                const Token &op = previous();
                 Expression::Ptr right = factor();
-                expr = std::make_shared<Binary_Expression>(op, std::move(expr), std::move(right));
+                expr = make<Binary_Expression>(op, std::move(expr), std::move(right));
             }
             return expr;
         }
@@ -133,9 +156,9 @@ class Parser {
         Expression::Ptr factor() {
             Expression::Ptr expr = unary();
             while (match(Token_Type::STAR, Token_Type::SLASH)) {
-                Token op = previous();
+                const Token &op = previous();
                 Expression::Ptr right = unary();
-                expr = std::make_shared<Binary_Expression>(op, std::move(expr), std::move(right));
+                expr = make<Binary_Expression>(op, std::move(expr), std::move(right));
             }
             return expr;
         }
@@ -150,8 +173,8 @@ class Parser {
                     arguments.push_back(expression());
                 } while (match(Token_Type::COMMA));
             }
-            Token paren = consume(Token_Type::RIGHT_PAREN, "Expect ')' after arguments.");
-            return std::make_shared<Call_Expression>(std::move(callee), paren, std::move(arguments));
+            const Token &paren = consume(Token_Type::RIGHT_PAREN, "Expect ')' after arguments.");
+            return make<Call_Expression>(std::move(callee), paren, std::move(arguments));
         }
 
         Expression::Ptr call() {
@@ -159,6 +182,9 @@ class Parser {
             for (;;) {
                 if (match(Token_Type::LEFT_PAREN)) {
                     expr = finish_call(std::move(expr));
+                } else if (match(Token_Type::DOT)) {
+                    const Token &name = consume(Token_Type::IDENTIFIER, "Expect property name after '.'.");
+                    expr = make<Get_Expression>(std::move(expr), name);
                 } else {
                     break;
                 }
@@ -168,41 +194,52 @@ class Parser {
 
         Expression::Ptr unary() {
             if (match(Token_Type::BANG, Token_Type::MINUS)) {
-                Token op = previous();
+                const Token &op = previous();
                 Expression::Ptr right = unary();
-                return std::make_shared<Unary>(op, std::move(right));
+                return make<Unary>(op, std::move(right));
             }
             return call();
         }
 
 
-        static Exception error(const Token &token, const std::string& message) {
-            ::error(token, message);
+        Exception error(const Token &token, const std::string& message) const {
+            scanner_.reporter().error(token, scanner_.lexeme(token), message);
             return {};
         }
 
-        Token consume(const Token_Type &expected, const std::string& message) {
+        const Token &consume(const Token_Type &expected, const std::string& message) {
             if (check(expected)) { return advance(); }
             throw error(peek(), message);
         }
 
         Expression::Ptr primary() {
-            if (match(Token_Type::FALSE)) { return Literal::create(false); }
-            if (match(Token_Type::TRUE)) { return Literal::create(true); }
+            if (match(Token_Type::FALSE)) { return make<Bool_Literal>(false); }
+            if (match(Token_Type::TRUE)) { return make<Bool_Literal>(true); }
             if (match(Token_Type::NIL)) { return Literal::create(); }
             if (match(Token_Type::NUMBER)) {
-                return Literal::create(dynamic_cast<const Number_Literal &>(*previous().literal).value);
+                std::string_view text { scanner_.lexeme(previous()) };
+                double value { 0 };
+                std::from_chars(text.data(), text.data() + text.size(), value);
+                return make<Number_Literal>(value);
             }
             if (match(Token_Type::STRING)) {
-                return Literal::create(dynamic_cast<const String_Literal &>(*previous().literal).value);
+                std::string_view text { scanner_.lexeme(previous()) };
+                return make<String_Literal>(text.substr(1, text.size() - 2));
+            }
+            if (match(Token_Type::THIS)) { return make<This_Expression>(previous()); }
+            if (match(Token_Type::SUPER)) {
+                const Token &keyword = previous();
+                consume(Token_Type::DOT, "Expect '.' after 'super'.");
+                const Token &method = consume(Token_Type::IDENTIFIER, "Expect superclass method name.");
+                return make<Super_Expression>(keyword, method);
             }
             if (match(Token_Type::IDENTIFIER)) {
-                return std::make_shared<Var_Expression>(previous());
+                return make<Var_Expression>(previous());
             }
             if (match(Token_Type::LEFT_PAREN)) {
                 Expression::Ptr expr = expression();
                 consume(Token_Type::RIGHT_PAREN, "Expect ')' after expression.");
-                return std::make_shared<Grouping>(std::move(expr));
+                return make<Grouping>(std::move(expr));
             }
 
             throw error(peek(), "Expect expression.");
@@ -237,23 +274,23 @@ class Parser {
             if (match(Token_Type::ELSE)) {
                 else_branch = statement();
             }
-            return std::make_shared<If_Statement>(std::move(condition), std::move(then_branch), std::move(else_branch));
+            return make<If_Statement>(std::move(condition), std::move(then_branch), std::move(else_branch));
         }
 
         Statement::Ptr print_statement() {
             Expression::Ptr expr { expression() };
             consume(Token_Type::SEMICOLON, "Expect ';' after value.");
-            return std::make_shared<Print_Statement>(std::move(expr));
+            return make<Print_Statement>(std::move(expr));
         }
 
         Statement::Ptr return_statement() {
-            Token keyword = previous();
+            const Token &keyword = previous();
             Expression::Ptr value;
             if (! check(Token_Type::SEMICOLON)) {
                 value = expression();
             }
             consume(Token_Type::SEMICOLON, "Expect ';' after return value.");
-            return std::make_shared<Return_Statement>(keyword, value);
+            return make<Return_Statement>(keyword, value);
         }
 
         Statement::Ptr while_statement() {
@@ -261,7 +298,7 @@ class Parser {
             Expression::Ptr condition {expression() };
             consume(Token_Type::RIGHT_PAREN, "Expect ')' after while condition.");
             Statement::Ptr body { statement() };
-            return std::make_shared<While_Statement>(std::move(condition), std::move(body));
+            return make<While_Statement>(std::move(condition), std::move(body));
         }
 
         Block_Statement::Ptr block_statement() {
@@ -270,13 +307,13 @@ class Parser {
                 statements.push_back(declaration());
             }
             consume(Token_Type::RIGHT_BRACE, "Expect '}' after block.");
-            return std::make_shared<Block_Statement>(std::move(statements));
+            return make<Block_Statement>(std::move(statements));
         }
 
         Statement::Ptr expression_statement() {
             Expression::Ptr expr { expression() };
             consume(Token_Type::SEMICOLON, "Expect ';' after expression.");
-            return std::make_shared<Expression_Statement>(std::move(expr));
+            return make<Expression_Statement>(std::move(expr));
         }
 
         Statement::Ptr for_statement() {
@@ -295,7 +332,7 @@ class Parser {
             }
             consume(Token_Type::SEMICOLON, "Expect ';' after loop condition.");
             Expression::Ptr increment;
-            if (! check(Token_Type::LEFT_PAREN)) {
+            if (! check(Token_Type::RIGHT_PAREN)) {
                 increment = expression();
             }
             consume(Token_Type::RIGHT_PAREN, "Expect ')' after for clauses.");
@@ -303,17 +340,17 @@ class Parser {
             if (increment) {
                 std::vector<Statement::Ptr> statements;
                 statements.push_back(std::move(body));
-                statements.push_back(std::make_shared<Expression_Statement>(std::move(increment)));
-                body = std::make_shared<Block_Statement>(std::move(statements));
+                statements.push_back(make<Expression_Statement>(std::move(increment)));
+                body = make<Block_Statement>(std::move(statements));
             }
-            if (! condition) { condition = Literal::create(true); }
-            body = std::make_shared<While_Statement>(std::move(condition), std::move(body));
+            if (! condition) { condition = make<Bool_Literal>(true); }
+            body = make<While_Statement>(std::move(condition), std::move(body));
 
             if (initializer) {
                 std::vector<Statement::Ptr> statements;
                 statements.push_back(std::move(initializer));
                 statements.push_back(std::move(body));
-                body = std::make_shared<Block_Statement>(std::move(statements));
+                body = make<Block_Statement>(std::move(statements));
             }
 
             return body;
@@ -330,19 +367,19 @@ class Parser {
         }
 
         Statement::Ptr var_declaration() {
-            Token name = consume(Token_Type::IDENTIFIER, "Expect variable name.");
+            const Token &name = consume(Token_Type::IDENTIFIER, "Expect variable name.");
             Expression::Ptr initializer;
             if (match(Token_Type::EQUAL)) {
                 initializer = expression();
             }
             consume(Token_Type::SEMICOLON, "Expect ';' after variable declaration.");
-            return std::make_shared<Var_Statement>(name, std::move(initializer));
+            return make<Var_Statement>(name, std::move(initializer));
         }
 
-        Statement::Ptr function_definition(const std::string &kind) {
-            Token name = consume(Token_Type::IDENTIFIER, "Expect " + kind + " name.");
+        Function_Definition::Ptr function_definition(const std::string &kind) {
+            const Token &name = consume(Token_Type::IDENTIFIER, "Expect " + kind + " name.");
             consume(Token_Type::LEFT_PAREN, "Expect '(' after " + kind + " name.");
-            std::vector<Token> params;
+            std::vector<Identifier> params;
             if (!check(Token_Type::RIGHT_PAREN)) {
                 do {
                     if (params.size() >= 255) {
@@ -354,11 +391,34 @@ class Parser {
             consume(Token_Type::RIGHT_PAREN, "Expect ')' after parameters.");
             consume(Token_Type::LEFT_BRACE, "Expect '{' before " + kind + " body.");
             Block_Statement::Ptr body = block_statement();
-            return std::make_shared<Function_Definition>(name, std::move(params), std::move(body));
+            Function_Kind function_kind { Function_Kind::FUNCTION };
+            if (kind == "method") {
+                function_kind = scanner_.lexeme(name) == "init" ? Function_Kind::INITIALIZER : Function_Kind::METHOD;
+            }
+            return make<Function_Definition>(name, std::move(params), std::move(body), function_kind);
+        }
+
+        Statement::Ptr class_declaration() {
+            const Token &name = consume(Token_Type::IDENTIFIER, "Expect class name.");
+            std::shared_ptr<const Var_Expression> superclass;
+            if (match(Token_Type::LESS)) {
+                consume(Token_Type::IDENTIFIER, "Expect superclass name.");
+                superclass = make<Var_Expression>(previous());
+            }
+            consume(Token_Type::LEFT_BRACE, "Expect '{' before class body.");
+            std::vector<Function_Definition::Ptr> methods;
+            while (! check(Token_Type::RIGHT_BRACE) && ! is_at_end()) {
+                methods.push_back(function_definition("method"));
+            }
+            consume(Token_Type::RIGHT_BRACE, "Expect '}' after class body.");
+            return make<Class_Statement>(name, std::move(superclass), std::move(methods));
         }
 
         Statement::Ptr declaration() {
             try {
+                if (match(Token_Type::CLASS)) {
+                    return class_declaration();
+                }
                 if (match(Token_Type::FUN)) {
                     return function_definition("function");
                 }
@@ -374,12 +434,40 @@ class Parser {
         }
 
     public:
-        explicit Parser(const std::vector<Token> &tokens): tokens_ { tokens } { }
+        // The parser pulls tokens from the scanner as it goes; the scanner
+        // has to outlive it.
+        explicit Parser(Scanner &scanner): scanner_ { scanner } { }
+        Parser(const Parser &) = delete;
+        Parser &operator=(const Parser &) = delete;
+        ~Parser() { arena_->release(); }
+
+        [[nodiscard]] bool is_at_end() const { return peek().type == Token_Type::END_OF_DATA; }
+
+        // where the nodes parsed last were made, for the Optimizer to make
+        // the nodes it rewrites them into next to them
+        [[nodiscard]] Ast_Arena *arena() const { return arena_; }
+
+        // nodes made so far, for --stats; nil literals are null and not counted
+        [[nodiscard]] std::size_t nodes() const { return nodes_; }
+        [[nodiscard]] std::size_t literals() const { return literals_; }
+
+        // Parses the next top-level declaration and releases its tokens.
+        // Once the arena has grown past a block, later declarations start a
+        // new one, so the nodes of declarations that are gone can be freed.
+        Statement::Ptr parse_declaration() {
+            if (arena_->size() >= Ast_Arena::block_size) {
+                arena_->release();
+                arena_ = Ast_Arena::create();
+            }
+            Statement::Ptr statement { declaration() };
+            scanner_.release(current_);
+            return statement;
+        }
 
         std::vector<Statement::Ptr> parse() {
             std::vector<Statement::Ptr> statements;
             while (! is_at_end()) {
-                statements.push_back(declaration());
+                statements.push_back(parse_declaration());
             }
             return statements;
         }
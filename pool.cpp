@@ -0,0 +1,32 @@
+#include "pool.h"
+
+void *Pool::carve(std::size_t size) {
+    if (static_cast<std::size_t>(end_ - next_) < size) {
+        // what is left of the old chunk is too small for this class and is
+        // dropped
+        next_ = static_cast<std::byte *>(::operator new(chunk_size));
+        end_ = next_ + chunk_size;
+        ++stats.chunks;
+    }
+    void *block { next_ };
+    next_ += size;
+    return block;
+}
+
+void *Pool::take(std::size_t size) {
+    std::size_t index { size == 0 ? 0 : (size - 1) / granule };
+    ++stats.allocations;
+    if (Block *block { free_[index] }) {
+        free_[index] = block->next;
+        ++stats.reused;
+        return block;
+    }
+    return carve((index + 1) * granule);
+}
+
+void Pool::give(void *pointer, std::size_t size) {
+    std::size_t index { size == 0 ? 0 : (size - 1) / granule };
+    auto *block { static_cast<Block *>(pointer) };
+    block->next = free_[index];
+    free_[index] = block;
+}
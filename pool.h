@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstddef>
+#include <new>
+
+// Free lists by size class for the small blocks the interpreter makes and
+// drops all the time: heap nodes, the slots of environments and folded
+// literals. Sizes round up to a multiple of 16; each class takes new blocks
+// from the chunk being carved and reuses freed ones first. Every thread has
+// pools of its own, so nothing takes a lock. Memory is never given back: a
+// block freed on another thread joins that thread's lists, and chunks
+// outlive the thread that made them. Larger blocks, and all of them when
+// built with LOX_POOL off, go to operator new.
+class Pool {
+        static constexpr std::size_t granule { 16 };
+        static constexpr std::size_t classes { 16 };
+        static constexpr std::size_t chunk_size { 64 * 1024 };
+
+        struct Block {
+            Block *next;
+        };
+
+        Block *free_[classes] { };
+        std::byte *next_ = nullptr;
+        std::byte *end_ = nullptr;
+
+        void *carve(std::size_t size);
+        void *take(std::size_t size);
+        void give(void *pointer, std::size_t size);
+
+        // constant initialized, so using it costs no guard
+        static Pool &local() {
+            static thread_local Pool pool;
+            return pool;
+        }
+
+    public:
+        static constexpr std::size_t max_size { granule * classes };
+#ifdef LOX_POOL
+        static constexpr bool enabled { true };
+#else
+        static constexpr bool enabled { false };
+#endif
+
+        struct Stats {
+            std::size_t allocations = 0;
+            std::size_t reused = 0;
+            std::size_t chunks = 0;
+        };
+
+        Stats stats;
+
+        // the pools of the calling thread, for --gc-stats
+        [[nodiscard]] static const Stats &thread_stats() { return local().stats; }
+        // starts counting afresh, for a thread that runs one script after
+        // another
+        static void reset_thread_stats() { local().stats = { }; }
+
+        static void *allocate(std::size_t size) {
+#ifdef LOX_POOL
+            if (size <= max_size) { return local().take(size); }
+#endif
+            return ::operator new(size);
+        }
+
+        static void deallocate(void *pointer, std::size_t size) {
+#ifdef LOX_POOL
+            if (size <= max_size) {
+                local().give(pointer, size);
+                return;
+            }
+#endif
+            ::operator delete(pointer);
+        }
+};
+
+// Allocates from the Pool, for containers and std::allocate_shared.
+template<typename T> class Pool_Allocator {
+    public:
+        using value_type = T;
+
+        Pool_Allocator() = default;
+        template<typename U> Pool_Allocator(const Pool_Allocator<U> &) { }
+
+        T *allocate(std::size_t n) { return static_cast<T *>(Pool::allocate(n * sizeof(T))); }
+        void deallocate(T *pointer, std::size_t n) { Pool::deallocate(pointer, n * sizeof(T)); }
+
+        template<typename U> bool operator==(const Pool_Allocator<U> &) const { return true; }
+};
@@ -0,0 +1,76 @@
+#include "profiler.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <string_view>
+
+std::vector<std::string> Profiler::labels() const {
+    std::unordered_map<std::string_view, int> uses;
+    for (const auto &function : functions_) { ++uses[function.name]; }
+    std::vector<std::string> labels;
+    for (const auto &function : functions_) {
+        labels.push_back(function.name);
+        if (uses[function.name] > 1 && function.line > 0) { labels.back() += ":" + std::to_string(function.line); }
+    }
+    return labels;
+}
+
+void Profiler::enter(int function) {
+    int parent { frames_.empty() ? 0 : frames_.back().node };
+    auto [child, added] { nodes_[parent].children.emplace(function, static_cast<int>(nodes_.size())) };
+    int node { child->second };
+    if (added) { nodes_.push_back({ function, parent }); }
+    auto &entered { functions_[function] };
+    ++entered.calls;
+    ++entered.active;
+    frames_.push_back({ node, Clock::now() });
+}
+
+void Profiler::leave() {
+    auto elapsed { Clock::now() - frames_.back().start };
+    const Frame &frame { frames_.back() };
+    auto &node { nodes_[frame.node] };
+    auto &left { functions_[node.function] };
+    auto self { elapsed - frame.children };
+    node.self += self;
+    left.exclusive += self;
+    if (--left.active == 0) { left.inclusive += elapsed; }
+    frames_.pop_back();
+    if (! frames_.empty()) { frames_.back().children += elapsed; }
+}
+
+void Profiler::report(std::ostream &out) const {
+    auto names { labels() };
+    std::vector<int> sorted;
+    for (int function = 0; function < static_cast<int>(functions_.size()); ++function) { sorted.push_back(function); }
+    std::sort(sorted.begin(), sorted.end(), [this](int a, int b) {
+        return functions_[a].exclusive > functions_[b].exclusive;
+    });
+    auto millis { [](Clock::duration duration) { return std::chrono::duration<double, std::milli>(duration).count(); } };
+    out << std::setw(10) << "calls" << std::setw(12) << "incl ms" << std::setw(12) << "excl ms" << "  function\n";
+    for (int index : sorted) {
+        const auto &function { functions_[index] };
+        out << std::setw(10) << function.calls << std::fixed << std::setprecision(3)
+            << std::setw(12) << millis(function.inclusive) << std::setw(12) << millis(function.exclusive)
+            << "  " << names[index] << "\n";
+    }
+}
+
+void Profiler::path(const std::vector<std::string> &labels, int node, std::string &out) const {
+    if (nodes_[node].parent > 0) {
+        path(labels, nodes_[node].parent, out);
+        out += ';';
+    }
+    out += labels[nodes_[node].function];
+}
+
+void Profiler::write_collapsed(std::ostream &out) const {
+    auto names { labels() };
+    for (int node = 1; node < static_cast<int>(nodes_.size()); ++node) {
+        auto nanos { std::chrono::duration_cast<std::chrono::nanoseconds>(nodes_[node].self).count() };
+        if (nanos == 0) { continue; }
+        std::string line;
+        path(names, node, line);
+        out << line << " " << nanos << "\n";
+    }
+}
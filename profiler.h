@@ -0,0 +1,100 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Times every call of a Lox function or native for --profile. Functions are
+// told apart by the definition or native they run and reported by name,
+// Class.method for a method, with the line of the definition added where
+// two of them share a name. The call tree keeps the time spent in each
+// function by the path of calls that led to it. Callers check enabled
+// first, so a run without --profile pays one branch per call.
+class Profiler {
+        using Clock = std::chrono::steady_clock;
+
+        struct Function {
+            std::string name;
+            int line;
+            std::size_t calls = 0;
+            Clock::duration inclusive { };
+            Clock::duration exclusive { };
+            // calls on the stack, so recursion counts into inclusive once
+            int active = 0;
+        };
+
+        // a path in the call tree; node 0 is the root, outside any call
+        struct Node {
+            int function;
+            int parent;
+            std::unordered_map<int, int> children;
+            Clock::duration self { };
+        };
+
+        struct Frame {
+            int node;
+            Clock::time_point start;
+            Clock::duration children { };
+        };
+
+        std::unordered_map<const void *, int> ids_;
+        std::vector<Function> functions_;
+        std::vector<Node> nodes_ { Node { -1, -1 } };
+        std::vector<Frame> frames_;
+
+        Profiler() = default;
+
+        void enter(int function);
+        // the names the rows are reported by, in the order of functions_
+        [[nodiscard]] std::vector<std::string> labels() const;
+        void path(const std::vector<std::string> &labels, int node, std::string &out) const;
+
+    public:
+        // what a row is named by; natives have no line
+        struct Label {
+            std::string name;
+            int line = 0;
+        };
+
+        static inline bool enabled = false;
+        // where --profile writes the collapsed stacks
+        static inline std::string output { "lox.folded" };
+
+        // the calls of the calling thread
+        static Profiler &instance() {
+            static thread_local Profiler profiler;
+            return profiler;
+        }
+
+        // Enters a call of what key identifies; label() is only asked the
+        // first time the key is seen.
+        template<typename Labeler> void enter(const void *key, Labeler &&label) {
+            auto got { ids_.find(key) };
+            if (got == ids_.end()) {
+                Label named { label() };
+                got = ids_.emplace(key, static_cast<int>(functions_.size())).first;
+                functions_.push_back({ std::move(named.name), named.line });
+            }
+            enter(got->second);
+        }
+
+        void leave();
+
+        [[nodiscard]] std::size_t depth() const { return frames_.size(); }
+
+        // leaves the calls a runtime error abandoned, down to depth
+        void unwind(std::size_t depth) {
+            while (frames_.size() > depth) { leave(); }
+        }
+
+        // a table by exclusive time, most first
+        void report(std::ostream &out) const;
+
+        // One line per call path: the function names from the outermost
+        // call, separated by ';', and the nanoseconds spent in the last
+        // one itself. This is the input flamegraph.pl and similar tools take.
+        void write_collapsed(std::ostream &out) const;
+};
@@ -0,0 +1,149 @@
+#pragma once
+
+#include <algorithm>
+#include <vector>
+
+#include "assign_expression.h"
+#include "binary_expression.h"
+#include "block_statement.h"
+#include "call_expression.h"
+#include "class_statement.h"
+#include "expression.h"
+#include "expression_statement.h"
+#include "function_definition.h"
+#include "get_expression.h"
+#include "grouping.h"
+#include "if_statement.h"
+#include "literal.h"
+#include "logical_expression.h"
+#include "print_statement.h"
+#include "return_statement.h"
+#include "set_expression.h"
+#include "statement.h"
+#include "super_expression.h"
+#include "symbol.h"
+#include "this_expression.h"
+#include "unary.h"
+#include "var_expression.h"
+#include "var_statement.h"
+#include "while_statement.h"
+
+// Marks the functions whose result depends on nothing but their arguments.
+// Such a body prints nothing, touches no global other than to call the
+// function it names, captures no variables, uses no fields and defines no
+// functions or classes of its own. An initializer is never pure, as every
+// call has a new instance to set up. Whether the functions it calls are pure
+// depends on what the globals hold when it runs, so their names are
+// recorded for the caller to check. Runs after the Resolver, which tells
+// locals from globals and captures.
+class Purity: public Expression_Visitor, public Statement_Visitor {
+        // the function being analyzed, null at the top level
+        const Function_Definition *function_ = nullptr;
+        bool pure_ = true;
+        std::vector<Symbol> callees_;
+
+        void analyze(const Expression::Ptr &expression) {
+            if (expression && function_) { expression->accept(*this); }
+        }
+
+        void analyze(const Statement::Ptr &statement) {
+            if (statement) { statement->accept(*this); }
+        }
+
+    public:
+        void analyze(const std::vector<Statement::Ptr> &statements) {
+            for (const auto &statement : statements) { analyze(statement); }
+        }
+
+        void visit(const Binary_Expression &binary) override {
+            analyze(binary.left);
+            analyze(binary.right);
+        }
+
+        void visit(const Grouping &grouping) override { analyze(grouping.expression); }
+
+        void visit(const Literal &literal) override { }
+
+        void visit(const Unary &unary) override { analyze(unary.right); }
+
+        void visit(const Var_Expression &expression) override {
+            if (expression.depth < 0) { pure_ = false; }
+        }
+
+        void visit(const Assign_Expression &expression) override {
+            if (expression.depth < 0) { pure_ = false; }
+            analyze(expression.value);
+        }
+
+        void visit(const Logical_Expression &expression) override {
+            analyze(expression.left);
+            analyze(expression.right);
+        }
+
+        void visit(const Call_Expression &expression) override {
+            auto callee { dynamic_cast<const Var_Expression *>(expression.callee.get()) };
+            if (callee && callee->depth < 0 && callee->upvalue < 0) {
+                if (std::find(callees_.begin(), callees_.end(), callee->name.symbol) == callees_.end()) {
+                    callees_.push_back(callee->name.symbol);
+                }
+            } else {
+                pure_ = false;
+            }
+            for (const auto &argument : expression.arguments) { analyze(argument); }
+        }
+
+        void visit(const Print_Statement &statement) override {
+            if (function_) { pure_ = false; }
+        }
+
+        void visit(const Expression_Statement &statement) override { analyze(statement.expression); }
+
+        void visit(const Var_Statement &statement) override { analyze(statement.initializer); }
+
+        void visit(const Block_Statement &statement) override { analyze(statement.statements); }
+
+        void visit(const If_Statement &statement) override {
+            analyze(statement.condition);
+            analyze(statement.then_branch);
+            analyze(statement.else_branch);
+        }
+
+        void visit(const While_Statement &statement) override {
+            analyze(statement.condition);
+            analyze(statement.body);
+        }
+
+        void visit(const Function_Definition &statement) override {
+            const Function_Definition *function { function_ };
+            std::vector<Symbol> callees { std::move(callees_) };
+
+            function_ = &statement;
+            pure_ = true;
+            callees_.clear();
+            if (statement.body) { analyze(statement.body->statements); }
+            statement.pure = pure_ && statement.kind != Function_Kind::INITIALIZER;
+            statement.callees = std::move(callees_);
+
+            // the body is analyzed on its own; defining a function is a side
+            // effect of the enclosing one
+            function_ = function;
+            pure_ = false;
+            callees_ = std::move(callees);
+        }
+
+        void visit(const Return_Statement &statement) override { analyze(statement.value); }
+
+        // fields can change between calls
+        void visit(const Get_Expression &expression) override { pure_ = false; }
+
+        void visit(const Set_Expression &expression) override { pure_ = false; }
+
+        void visit(const This_Expression &expression) override { }
+
+        void visit(const Super_Expression &expression) override { pure_ = false; }
+
+        void visit(const Class_Statement &statement) override {
+            for (const auto &method : statement.methods) { visit(*method); }
+            pure_ = false;
+        }
+};
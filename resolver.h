@@ -0,0 +1,297 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "assign_expression.h"
+#include "binary_expression.h"
+#include "block_statement.h"
+#include "call_expression.h"
+#include "class_statement.h"
+#include "err.h"
+#include "expression.h"
+#include "expression_statement.h"
+#include "function_definition.h"
+#include "get_expression.h"
+#include "grouping.h"
+#include "if_statement.h"
+#include "literal.h"
+#include "logical_expression.h"
+#include "print_statement.h"
+#include "return_statement.h"
+#include "set_expression.h"
+#include "statement.h"
+#include "super_expression.h"
+#include "this_expression.h"
+#include "identifier.h"
+#include "token.h"
+#include "unary.h"
+#include "var_expression.h"
+#include "var_statement.h"
+#include "while_statement.h"
+
+// Binds every variable reference to an (environment hops, slot) pair before
+// the program runs. Each function body starts a fresh scope chain, and
+// blocks that declare nothing are transparent and do not count as a hop.
+// A function that refers to a local of an enclosing function captures it:
+// the variable is marked to live in a Cell, which the closure copies when it
+// is defined, and the reference becomes an index into the closure's cells.
+// Everything no closure captures stays in plain frame slots. Methods declare
+// `this` in slot 0 and the methods of a subclass capture `super` from a
+// scope around them. Misuse of either is reported as a static error.
+class Resolver: public Expression_Visitor, public Statement_Visitor {
+        struct Local {
+            int slot;
+            bool captured = false;
+            // flags of the declarations and references to the variable,
+            // raised when a closure captures it
+            std::vector<bool *> boxed;
+        };
+
+        struct Scope {
+            std::map<Symbol, Local> locals;
+            bool has_environment;
+            int size = 0;
+        };
+
+        // the scopes of one function body, or of the top level
+        struct Function_Scope {
+            const Function_Definition *definition;
+            std::vector<Scope> scopes;
+        };
+
+        enum class Class_Kind { NONE, CLASS, SUBCLASS };
+
+        Reporter &reporter_;
+        std::vector<Function_Scope> functions_ { { nullptr, { } } };
+        Class_Kind class_ = Class_Kind::NONE;
+
+        std::vector<Scope> &scopes() { return functions_.back().scopes; }
+
+        void resolve(const Expression::Ptr &expression) {
+            if (expression) { expression->accept(*this); }
+        }
+
+        void resolve(const Statement::Ptr &statement) {
+            if (statement) { statement->accept(*this); }
+        }
+
+        int declare(const Identifier &name, bool &captured) {
+            if (scopes().empty()) { return -1; }
+            auto &scope { scopes().back() };
+            auto got { scope.locals.find(name.symbol) };
+            if (got == scope.locals.end()) { got = scope.locals.emplace(name.symbol, Local { scope.size++ }).first; }
+            captured = got->second.captured;
+            got->second.boxed.push_back(&captured);
+            return got->second.slot;
+        }
+
+        static Local *find(Function_Scope &function, Symbol name, int &depth, int &slot) {
+            int hops { 0 };
+            for (auto i { function.scopes.rbegin() }; i != function.scopes.rend(); ++i) {
+                auto got { i->locals.find(name) };
+                if (got != i->locals.end()) {
+                    depth = hops;
+                    slot = got->second.slot;
+                    return &got->second;
+                }
+                if (i->has_environment) { ++hops; }
+            }
+            return nullptr;
+        }
+
+        // the index of the variable in the captures of the function at
+        // this nesting level, or -1 for a global
+        int capture(std::size_t level, Symbol name) {
+            if (level == 0) { return -1; }
+            auto &captures { functions_[level].definition->captures };
+            for (std::size_t i = 0; i < captures.size(); ++i) {
+                if (captures[i].name == name) { return static_cast<int>(i); }
+            }
+
+            int depth { -1 };
+            int slot { -1 };
+            if (Local *local { find(functions_[level - 1], name, depth, slot) }) {
+                local->captured = true;
+                for (bool *boxed : local->boxed) { *boxed = true; }
+            } else if (slot = capture(level - 1, name); slot < 0) {
+                return -1;
+            }
+            captures.push_back({ name, depth, slot });
+            return static_cast<int>(captures.size()) - 1;
+        }
+
+        void resolve_local(const Identifier &name, int &depth, int &slot, bool &boxed, int &upvalue) {
+            upvalue = -1;
+            if (Local *local { find(functions_.back(), name.symbol, depth, slot) }) {
+                boxed = local->captured;
+                local->boxed.push_back(&boxed);
+                return;
+            }
+            depth = -1;
+            slot = -1;
+            upvalue = capture(functions_.size() - 1, name.symbol);
+        }
+
+    public:
+        // whether a block with these statements needs an environment of its own
+        static bool declares(const std::vector<Statement::Ptr> &statements) {
+            for (const auto &statement : statements) {
+                if (dynamic_cast<const Var_Statement *>(statement.get())) { return true; }
+                if (dynamic_cast<const Function_Definition *>(statement.get())) { return true; }
+                if (dynamic_cast<const Class_Statement *>(statement.get())) { return true; }
+            }
+            return false;
+        }
+
+        explicit Resolver(Reporter &reporter): reporter_ { reporter } { }
+
+        void resolve(const std::vector<Statement::Ptr> &statements) {
+            for (const auto &statement : statements) { resolve(statement); }
+        }
+
+        void visit(const Binary_Expression &binary) override {
+            resolve(binary.left);
+            resolve(binary.right);
+        }
+
+        void visit(const Grouping &grouping) override { resolve(grouping.expression); }
+
+        void visit(const Literal &literal) override { }
+
+        void visit(const Unary &unary) override { resolve(unary.right); }
+
+        void visit(const Var_Expression &expression) override {
+            resolve_local(expression.name, expression.depth, expression.slot, expression.boxed, expression.upvalue);
+        }
+
+        void visit(const Assign_Expression &expression) override {
+            resolve(expression.value);
+            resolve_local(expression.name, expression.depth, expression.slot, expression.boxed, expression.upvalue);
+        }
+
+        void visit(const Logical_Expression &expression) override {
+            resolve(expression.left);
+            resolve(expression.right);
+        }
+
+        void visit(const Call_Expression &expression) override {
+            resolve(expression.callee);
+            for (const auto &argument : expression.arguments) { resolve(argument); }
+        }
+
+        void visit(const Print_Statement &statement) override { resolve(statement.expression); }
+
+        void visit(const Expression_Statement &statement) override { resolve(statement.expression); }
+
+        void visit(const Var_Statement &statement) override {
+            resolve(statement.initializer);
+            statement.slot = declare(statement.name, statement.captured);
+        }
+
+        void visit(const Block_Statement &statement) override {
+            scopes().push_back({ { }, declares(statement.statements) });
+            resolve(statement.statements);
+            statement.frame_size = scopes().back().size;
+            scopes().pop_back();
+        }
+
+        void visit(const If_Statement &statement) override {
+            resolve(statement.condition);
+            resolve(statement.then_branch);
+            resolve(statement.else_branch);
+        }
+
+        void visit(const While_Statement &statement) override {
+            resolve(statement.condition);
+            resolve(statement.body);
+        }
+
+        void visit(const Function_Definition &statement) override {
+            statement.slot = declare(statement.name, statement.captured);
+            resolve_function(statement);
+        }
+
+        void resolve_function(const Function_Definition &statement) {
+            functions_.push_back({ &statement, { { { }, true } } });
+            auto &scope { scopes().back() };
+            std::vector<Symbol> arguments;
+            if (statement.is_method()) { arguments.push_back(Symbol_Table::instance().intern("this")); }
+            for (const auto &param : statement.params) { arguments.push_back(param.symbol); }
+            for (Symbol argument : arguments) { scope.locals[argument] = { scope.size++ }; }
+            if (statement.body) { resolve(statement.body->statements); }
+
+            // nested functions may have grown functions_ in the meantime
+            const auto &locals { scopes().back().locals };
+            statement.frame_size = scopes().back().size;
+            statement.captured_params.clear();
+            for (Symbol argument : arguments) {
+                const auto &local { locals.at(argument) };
+                if (local.captured) { statement.captured_params.push_back(local.slot); }
+            }
+            functions_.pop_back();
+        }
+
+        void visit(const Return_Statement &statement) override {
+            const Function_Definition *function { functions_.back().definition };
+            if (! function) { reporter_.error(statement.keyword.line, "Can't return from top-level code."); }
+            if (statement.value && function && function->kind == Function_Kind::INITIALIZER) {
+                reporter_.error(statement.keyword.line, "Can't return a value from an initializer.");
+            }
+            resolve(statement.value);
+        }
+
+        void visit(const Get_Expression &expression) override { resolve(expression.object); }
+
+        void visit(const Set_Expression &expression) override {
+            resolve(expression.value);
+            resolve(expression.object);
+        }
+
+        void visit(const This_Expression &expression) override {
+            if (class_ == Class_Kind::NONE) {
+                reporter_.error(expression.name.line, "Can't use 'this' outside of a class.");
+                return;
+            }
+            visit(static_cast<const Var_Expression &>(expression));
+        }
+
+        void visit(const Super_Expression &expression) override {
+            if (class_ == Class_Kind::NONE) {
+                reporter_.error(expression.keyword.line, "Can't use 'super' outside of a class.");
+                return;
+            }
+            if (class_ != Class_Kind::SUBCLASS) {
+                reporter_.error(expression.keyword.line, "Can't use 'super' in a class with no superclass.");
+                return;
+            }
+            visit(expression.superclass);
+            visit(expression.receiver);
+        }
+
+        void visit(const Class_Statement &statement) override {
+            statement.slot = declare(statement.name, statement.captured);
+            Class_Kind enclosing { std::exchange(class_, Class_Kind::CLASS) };
+            if (statement.superclass) {
+                if (statement.superclass->name.symbol == statement.name.symbol) {
+                    reporter_.error(statement.superclass->name.line, "A class can't inherit from itself.");
+                }
+                resolve(statement.superclass);
+                class_ = Class_Kind::SUBCLASS;
+                scopes().push_back({ { }, true });
+                auto &scope { scopes().back() };
+                scope.locals.emplace(Symbol_Table::instance().intern("super"), Local { scope.size++ });
+            }
+            for (const auto &method : statement.methods) {
+                method->owner = statement.name.lexeme();
+                resolve_function(*method);
+            }
+            if (statement.superclass) {
+                statement.super_captured = scopes().back().locals.begin()->second.captured;
+                scopes().pop_back();
+            }
+            class_ = enclosing;
+        }
+};
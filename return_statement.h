@@ -4,15 +4,22 @@
 
 #include <memory>
 
+#include "call_expression.h"
 #include "expression.h"
 #include "token.h"
 
 class Return_Statement: public Statement {
 public:
-    const Token keyword;
+    const Node_Token keyword;
     const Expression::Ptr value;
 
-    explicit Return_Statement(const Token& t, Expression::Ptr v): keyword { t }, value { std::move(v) } { }
+    // the value if it is a call: a call in tail position runs in place of
+    // the returning function instead of nesting inside it
+    const Call_Expression *const tail_call;
+
+    explicit Return_Statement(const Node_Token &t, Expression::Ptr v):
+            keyword { t }, value { std::move(v) }, tail_call { dynamic_cast<const Call_Expression *>(value.get()) }
+    { }
 
     void accept(Statement_Visitor &visitor) const override { visitor.visit(*this); }
 };
@@ -0,0 +1,47 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include "scanner.h"
+
+// Scans a file repeatedly, alternating between the scalar and the vector
+// byte searches, and reports the best throughput of each in MB/s.
+
+static double scan(const std::string &source) {
+    Reporter reporter { std::cerr };
+    Scanner scanner { source, reporter };
+    auto start { std::chrono::steady_clock::now() };
+    for (std::size_t index = 0; scanner.token(index).type != Token_Type::END_OF_DATA; ++index) {
+        if (index % 4096 == 0) { scanner.release(index); }
+    }
+    std::chrono::duration<double> spent { std::chrono::steady_clock::now() - start };
+    return static_cast<double>(source.size()) / spent.count() / 1e6;
+}
+
+int main(int argc, const char *argv[]) {
+    if (argc < 2 || argc > 3) {
+        std::cerr << "Usage: " << argv[0] << " script [repeat]\n";
+        return EXIT_FAILURE;
+    }
+    std::ifstream in(argv[1]);
+    std::string source {
+        std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()
+    };
+    int repeat { argc == 3 ? std::atoi(argv[2]) : 10 };
+
+    double scalar { 0 };
+    double vector { 0 };
+    for (int i = 0; i < repeat; ++i) {
+        Scanner::vectorized = false;
+        scalar = std::max(scalar, scan(source));
+        Scanner::vectorized = true;
+        vector = std::max(vector, scan(source));
+    }
+
+    std::cout << "scalar: " << scalar << " MB/s\n";
+    std::cout << "vector: " << vector << " MB/s\n";
+    return EXIT_SUCCESS;
+}
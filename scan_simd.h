@@ -0,0 +1,138 @@
+#pragma once
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Byte-run searches the scanner uses for whitespace, comments, string bodies
+// and identifiers. Each returns the length of the run starting at begin, that
+// is the offset of the first byte that ends it, or end - begin if none does.
+class Scalar_Scan {
+    public:
+        [[nodiscard]] static bool is_blank(char ch) { return ch == ' ' || ch == '\t' || ch == '\r'; }
+        [[nodiscard]] static bool is_word(char ch) {
+            return (ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z') || (ch >= '0' && ch <= '9') || ch == '_';
+        }
+
+        static std::size_t blanks(const char *begin, const char *end) {
+            const char *at { begin };
+            while (at < end && is_blank(*at)) { ++at; }
+            return at - begin;
+        }
+
+        static std::size_t word(const char *begin, const char *end) {
+            const char *at { begin };
+            while (at < end && is_word(*at)) { ++at; }
+            return at - begin;
+        }
+
+        static std::size_t until(const char *begin, const char *end, char ch) {
+            const char *at { begin };
+            while (at < end && *at != ch) { ++at; }
+            return at - begin;
+        }
+
+        static std::size_t until_either(const char *begin, const char *end, char first, char second) {
+            const char *at { begin };
+            while (at < end && *at != first && *at != second) { ++at; }
+            return at - begin;
+        }
+};
+
+#if defined(__AVX2__) || defined(__SSE2__)
+
+// The handful of byte-wise operations the searches need, 32 bytes at a time
+// with AVX2 and 16 with SSE2.
+class Vector_Ops {
+    public:
+#if defined(__AVX2__)
+        using Reg = __m256i;
+        static constexpr std::size_t width { 32 };
+        static Reg load(const char *at) { return _mm256_loadu_si256(reinterpret_cast<const Reg *>(at)); }
+        static Reg splat(char ch) { return _mm256_set1_epi8(ch); }
+        static Reg eq(Reg a, Reg b) { return _mm256_cmpeq_epi8(a, b); }
+        static Reg gt(Reg a, Reg b) { return _mm256_cmpgt_epi8(a, b); }
+        static Reg either(Reg a, Reg b) { return _mm256_or_si256(a, b); }
+        static Reg both(Reg a, Reg b) { return _mm256_and_si256(a, b); }
+        static std::uint32_t mask(Reg a) { return static_cast<std::uint32_t>(_mm256_movemask_epi8(a)); }
+#else
+        using Reg = __m128i;
+        static constexpr std::size_t width { 16 };
+        static Reg load(const char *at) { return _mm_loadu_si128(reinterpret_cast<const Reg *>(at)); }
+        static Reg splat(char ch) { return _mm_set1_epi8(ch); }
+        static Reg eq(Reg a, Reg b) { return _mm_cmpeq_epi8(a, b); }
+        static Reg gt(Reg a, Reg b) { return _mm_cmpgt_epi8(a, b); }
+        static Reg either(Reg a, Reg b) { return _mm_or_si128(a, b); }
+        static Reg both(Reg a, Reg b) { return _mm_and_si128(a, b); }
+        static std::uint32_t mask(Reg a) { return static_cast<std::uint32_t>(_mm_movemask_epi8(a)); }
+#endif
+        static constexpr std::uint32_t full { width == 32 ? 0xffffffff : 0xffff };
+
+        // bytes in [low, high]; comparisons are signed, so bytes above 0x7f
+        // never fall in an ASCII range
+        static Reg in_range(Reg a, char low, char high) {
+            return both(gt(a, splat(static_cast<char>(low - 1))), gt(splat(static_cast<char>(high + 1)), a));
+        }
+};
+
+class Vector_Scan {
+        using V = Vector_Ops;
+
+        // Runs whole blocks while stop() reports no stopping byte, then
+        // leaves the tail to the scalar search. Most runs between tokens are
+        // empty or a single byte, so those are settled before any load.
+        template<typename Stop, typename Tail>
+        static std::size_t run(const char *begin, const char *end, Stop stop, Tail tail) {
+            const char *at { end - begin < 2 ? end : begin + 2 };
+            std::size_t head { tail(begin, at) };
+            if (head < 2) { return head; }
+            while (static_cast<std::size_t>(end - at) >= V::width) {
+                std::uint32_t mask { stop(V::load(at)) };
+                if (mask) { return at - begin + std::countr_zero(mask); }
+                at += V::width;
+            }
+            return at - begin + tail(at, end);
+        }
+
+    public:
+        static std::size_t blanks(const char *begin, const char *end) {
+            return run(begin, end, [](V::Reg block) {
+                V::Reg blank { V::either(V::eq(block, V::splat(' ')),
+                    V::either(V::eq(block, V::splat('\t')), V::eq(block, V::splat('\r')))) };
+                return ~V::mask(blank) & V::full;
+            }, Scalar_Scan::blanks);
+        }
+
+        static std::size_t word(const char *begin, const char *end) {
+            return run(begin, end, [](V::Reg block) {
+                V::Reg letter { V::in_range(V::either(block, V::splat(0x20)), 'a', 'z') };
+                V::Reg digit { V::in_range(block, '0', '9') };
+                V::Reg word { V::either(V::either(letter, digit), V::eq(block, V::splat('_'))) };
+                return ~V::mask(word) & V::full;
+            }, Scalar_Scan::word);
+        }
+
+        static std::size_t until(const char *begin, const char *end, char ch) {
+            return run(begin, end, [ch](V::Reg block) {
+                return V::mask(V::eq(block, V::splat(ch)));
+            }, [ch](const char *b, const char *e) { return Scalar_Scan::until(b, e, ch); });
+        }
+
+        static std::size_t until_either(const char *begin, const char *end, char first, char second) {
+            return run(begin, end, [first, second](V::Reg block) {
+                return V::mask(V::either(V::eq(block, V::splat(first)), V::eq(block, V::splat(second))));
+            }, [first, second](const char *b, const char *e) { return Scalar_Scan::until_either(b, e, first, second); });
+        }
+};
+
+#else
+
+using Vector_Scan = Scalar_Scan;
+
+#endif
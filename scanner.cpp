@@ -1,26 +1,107 @@
 #include "scanner.h"
 
+#include <algorithm>
+#include <array>
+
 #include "err.h"
+#include "scan_simd.h"
+
+bool Scanner::vectorized { true };
 
-std::map<std::string, Token_Type> Scanner::keywords_ = {
-        { "and", Token_Type::AND },
-        { "class", Token_Type::CLASS },
-        { "else", Token_Type::ELSE },
-        { "false", Token_Type::FALSE },
-        { "for", Token_Type::FOR },
-        { "fun", Token_Type::FUN },
-        { "if", Token_Type::IF },
-        { "nil", Token_Type::NIL },
-        { "or", Token_Type::OR },
-        { "print", Token_Type::PRINT },
-        { "return", Token_Type::RETURN },
-        { "super", Token_Type::SUPER },
-        { "this", Token_Type::THIS },
-        { "true", Token_Type::TRUE },
-        { "var", Token_Type::VAR },
-        { "while", Token_Type::WHILE }
+// Keywords are looked up by a perfect hash: the second letter and the length
+// select a distinct slot for each of them.
+struct Keyword {
+    std::string_view text;
+    Token_Type type;
 };
 
+static constexpr std::size_t keyword_hash(std::string_view text) {
+    return (static_cast<unsigned char>(text[1]) * 6 + text.size()) % 32;
+}
+
+static constexpr auto keyword_table { [] {
+    std::array<Keyword, 32> table { };
+    for (const Keyword &keyword: {
+        Keyword { "and", Token_Type::AND },
+        Keyword { "class", Token_Type::CLASS },
+        Keyword { "else", Token_Type::ELSE },
+        Keyword { "false", Token_Type::FALSE },
+        Keyword { "for", Token_Type::FOR },
+        Keyword { "fun", Token_Type::FUN },
+        Keyword { "if", Token_Type::IF },
+        Keyword { "nil", Token_Type::NIL },
+        Keyword { "or", Token_Type::OR },
+        Keyword { "print", Token_Type::PRINT },
+        Keyword { "return", Token_Type::RETURN },
+        Keyword { "super", Token_Type::SUPER },
+        Keyword { "this", Token_Type::THIS },
+        Keyword { "true", Token_Type::TRUE },
+        Keyword { "var", Token_Type::VAR },
+        Keyword { "while", Token_Type::WHILE }
+    }) {
+        auto &slot { table[keyword_hash(keyword.text)] };
+        if (! slot.text.empty()) { throw "keyword hash collision"; }
+        slot = keyword;
+    }
+    return table;
+}() };
+
+Token_Type Scanner::keyword(std::string_view text) {
+    if (text.size() < 2 || text.size() > 6) { return Token_Type::IDENTIFIER; }
+    const Keyword &got { keyword_table[keyword_hash(text)] };
+    return got.text == text ? got.type : Token_Type::IDENTIFIER;
+}
+
+static std::size_t blanks(const char *begin, const char *end) {
+    return Scanner::vectorized ? Vector_Scan::blanks(begin, end) : Scalar_Scan::blanks(begin, end);
+}
+
+static std::size_t word(const char *begin, const char *end) {
+    return Scanner::vectorized ? Vector_Scan::word(begin, end) : Scalar_Scan::word(begin, end);
+}
+
+static std::size_t line_end(const char *begin, const char *end) {
+    return Scanner::vectorized ? Vector_Scan::until(begin, end, '\n') : Scalar_Scan::until(begin, end, '\n');
+}
+
+static std::size_t string_end(const char *begin, const char *end) {
+    return Scanner::vectorized ?
+        Vector_Scan::until_either(begin, end, '"', '\n') : Scalar_Scan::until_either(begin, end, '"', '\n');
+}
+
+// Advances over the run that run() measures, reading more of a streamed
+// source while the run reaches the end of the buffer.
+template<typename Run> void Scanner::skip(Run run) {
+    do {
+        current_ += run(source_.data() + current_, source_.data() + source_.size());
+    } while (current_ == source_.size() && fill(1));
+}
+
+void Scanner::skip_trivia() {
+    for (;;) {
+        skip(blanks);
+        if (is_at_end()) { return; }
+        if (source_[current_] == '\n') {
+            ++line_;
+            ++current_;
+        } else if (source_[current_] == '/' && peek_next() == '/') {
+            skip(line_end);
+        } else {
+            return;
+        }
+    }
+}
+
+bool Scanner::refill(std::size_t ahead) {
+    while (source_.size() - current_ < ahead && in_ && *in_) {
+        std::size_t size { source_.size() };
+        source_.resize(size + chunk_size);
+        in_->read(source_.data() + size, chunk_size);
+        source_.resize(size + in_->gcount());
+    }
+    return source_.size() - current_ >= ahead;
+}
+
 bool Scanner::match(char ch) {
     if (is_at_end()) { return false; }
     if (source_[current_] != ch) { return false; }
@@ -29,17 +110,16 @@ bool Scanner::match(char ch) {
 }
 
 void Scanner::add_token(Token_Type type) {
-    std::string text { source_.substr(start_, current_ - start_) };
-    tokens_.emplace_back(type, text, line_);
+    tokens_.emplace_back(type, base_ + start_, current_ - start_, line_);
 }
 
-char Scanner::peek() const {
-    if (is_at_end()) { return '\0'; }
+char Scanner::peek() {
+    if (! fill(1)) { return '\0'; }
     return source_[current_];
 }
 
-char Scanner::peek_next() const {
-    if (current_ + 1 >= source_.length()) { return '\0'; }
+char Scanner::peek_next() {
+    if (! fill(2)) { return '\0'; }
     return source_[current_ + 1];
 }
 
@@ -51,23 +131,19 @@ bool Scanner::is_alpha(char ch) {
     return (ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z') || (ch == '_');
 }
 
-bool Scanner::is_alnum(char ch) {
-    return is_alpha(ch) || is_digit(ch);
-}
-
 void Scanner::parse_string() {
-    while (peek() != '"' && !is_at_end()) {
-        if (peek() == '\n') { ++line_; }
-        advance();
+    for (;;) {
+        skip(string_end);
+        if (is_at_end() || source_[current_] == '"') { break; }
+        ++line_;
+        ++current_;
     }
     if (is_at_end()) {
-        error(line_, "Unterminated string.");
+        reporter_.error(line_, "Unterminated string.");
         return;
     }
     advance();
-    std::string value = source_.substr(start_ + 1, current_ - start_ - 2);
-    std::string text { source_.substr(start_, current_ - start_) };
-    tokens_.emplace_back(Token_Type::STRING, text, value, line_);
+    add_token(Token_Type::STRING);
 }
 
 void Scanner::parse_number() {
@@ -76,21 +152,19 @@ void Scanner::parse_number() {
         advance();
         while (is_digit(peek())) { advance(); }
     }
-
-    double value = std::stod(source_.substr(start_, current_ - start_));
-    std::string text { source_.substr(start_, current_ - start_) };
-    tokens_.emplace_back(Token_Type::NUMBER, text, value, line_);
+    add_token(Token_Type::NUMBER);
 }
 
 void Scanner::parse_identifier() {
-    while (is_alnum(peek())) { advance(); }
+    skip(word);
 
-    std::string text { source_.substr(start_, current_ - start_) };
-    auto got { Scanner::keywords_.find(text) };
-    if (got != Scanner::keywords_.end()) {
-        add_token(got->second);
+    std::string_view text { std::string_view { source_ }.substr(start_, current_ - start_) };
+    Token_Type type { keyword(text) };
+    if (type != Token_Type::IDENTIFIER) {
+        add_token(type);
     } else {
-        add_token(Token_Type::IDENTIFIER);
+        Symbol symbol { Symbol_Table::instance().intern(text) };
+        tokens_.emplace_back(Token_Type::IDENTIFIER, base_ + start_, current_ - start_, symbol, line_);
     }
 }
 
@@ -111,14 +185,7 @@ void Scanner::scan_token() {
         case '=': add_token(match('=') ? Token_Type::EQUAL_EQUAL : Token_Type::EQUAL); break;
         case '<': add_token(match('=') ? Token_Type::LESS_EQUAL : Token_Type::LESS); break;
         case '>': add_token(match('=') ? Token_Type::GREATER_EQUAL : Token_Type::GREATER); break;
-        case '/': {
-            if (match('/')) {
-                while (peek() != '\n' && !is_at_end()) { advance(); }
-            } else { add_token(Token_Type::SLASH); }
-            break;
-        }
-        case ' ': case '\r': case '\t': break;
-        case '\n': ++line_; break;
+        case '/': add_token(Token_Type::SLASH); break;
         case '"': parse_string(); break;
         default:
             if (is_digit(c)) {
@@ -126,16 +193,41 @@ void Scanner::scan_token() {
             } else if (is_alpha(c)) {
                 parse_identifier();
             } else {
-                error(line_, "Unexpected character."); }
+                reporter_.error(line_, "Unexpected character."); }
             break;
     }
 }
 
-const std::vector<Token> &Scanner::scan_tokens() {
-    while (! is_at_end()) {
-        start_ = current_;
-        scan_token();
+const Token &Scanner::token(std::size_t index) {
+    while (index - first_ >= tokens_.size() && ! done_) {
+        skip_trivia();
+        if (is_at_end()) {
+            tokens_.emplace_back(Token_Type::END_OF_DATA, base_ + current_, 0, line_);
+            done_ = true;
+        } else {
+            start_ = current_;
+            scan_token();
+        }
+    }
+    return index - first_ < tokens_.size() ? tokens_[index - first_] : tokens_.back();
+}
+
+void Scanner::release(std::size_t index) {
+    std::size_t count { std::min(index - first_, tokens_.size()) };
+    if (done_ && count == tokens_.size()) { --count; }
+    for (std::size_t i { 0 }; i < count; ++i) { tokens_.pop_front(); }
+    first_ += count;
+
+    // a complete source string is kept as is; a streamed one drops the text
+    // in front of the oldest live token once that is at least half of it
+    if (! in_) { return; }
+    std::size_t dead { start_ };
+    if (! tokens_.empty()) {
+        dead = std::min(dead, static_cast<std::size_t>(lexeme(tokens_.front()).data() - source_.data()));
     }
-    tokens_.emplace_back(Token_Type::END_OF_DATA, "", line_);
-    return tokens_;
+    if (dead == 0 || dead < source_.size() / 2) { return; }
+    source_.erase(0, dead);
+    base_ += dead;
+    start_ -= dead;
+    current_ -= dead;
 }
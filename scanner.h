@@ -1,37 +1,80 @@
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <istream>
 #include <string>
-#include <vector>
-#include <map>
+#include <string_view>
 
+#include "err.h"
 #include "token.h"
 
+// Produces tokens on demand. The source is either a complete string or an
+// input stream that is read in chunks as scanning proceeds. Tokens are
+// addressed by their position in the whole stream; release() lets the
+// scanner forget tokens and source text the caller is done with.
 class Scanner {
-        static std::map<std::string, Token_Type> keywords_;
+        static constexpr std::size_t chunk_size { 64 * 1024 };
 
-        const std::string source_;
-        std::vector<Token> tokens_;
-        int start_ = 0;
-        int current_ = 0;
+        std::string source_;
+        std::istream *in_ = nullptr;
+        Reporter &reporter_;
+        // stream offset of source_[0]; token offsets are relative to the
+        // stream and wrap at 4GiB, which is harmless while the live window
+        // is smaller than that
+        std::size_t base_ = 0;
+        std::deque<Token> tokens_;
+        std::size_t first_ = 0;
+        bool done_ = false;
+        std::size_t start_ = 0;
+        std::size_t current_ = 0;
         int line_ = 1;
 
+        bool refill(std::size_t ahead);
+        bool fill(std::size_t ahead) { return source_.size() - current_ >= ahead || refill(ahead); }
+        template<typename Run> void skip(Run run);
+        void skip_trivia();
         char advance() { return source_[current_++]; }
         bool match(char ch);
-        [[nodiscard]] char peek() const;
-        [[nodiscard]] char peek_next() const;
+        [[nodiscard]] char peek();
+        [[nodiscard]] char peek_next();
         [[nodiscard]] static bool is_digit(char ch);
         [[nodiscard]] static bool is_alpha(char ch);
-        [[nodiscard]] static bool is_alnum(char ch);
+        [[nodiscard]] static Token_Type keyword(std::string_view text);
 
         void add_token(Token_Type type);
 
         void parse_string();
         void parse_number();
         void parse_identifier();
+        void scan_token();
+
     public:
-        explicit Scanner(std::string source): source_ { std::move(source) } { }
+        // picks the SIMD byte searches over the scalar ones
+        static bool vectorized;
 
-        [[nodiscard]] bool is_at_end() const { return current_ >= source_.length(); }
-        const std::vector<Token> &scan_tokens();
-        void scan_token();
+        Scanner(std::string source, Reporter &reporter): source_ { std::move(source) }, reporter_ { reporter } { }
+        Scanner(std::istream &in, Reporter &reporter): in_ { &in }, reporter_ { reporter } { }
+
+        // where the scanner and the parser reading from it report errors
+        [[nodiscard]] Reporter &reporter() const { return reporter_; }
+
+        [[nodiscard]] bool is_at_end() { return ! fill(1); }
+
+        // Token number index of the stream, scanning as far as needed. Past
+        // the end of input this is the END_OF_DATA token. References stay
+        // valid until the token is released.
+        const Token &token(std::size_t index);
+
+        // Forgets all tokens before index.
+        void release(std::size_t index);
+
+        // tokens scanned so far, not counting END_OF_DATA
+        [[nodiscard]] std::size_t scanned() const { return first_ + tokens_.size() - (done_ ? 1 : 0); }
+
+        [[nodiscard]] std::string_view lexeme(const Token &token) const {
+            auto offset { static_cast<std::uint32_t>(token.offset - static_cast<std::uint32_t>(base_)) };
+            return std::string_view { source_ }.substr(offset, token.length);
+        }
 };
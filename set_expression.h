@@ -0,0 +1,24 @@
+#pragma once
+
+#include "expression.h"
+
+#include <memory>
+#include <utility>
+
+#include "identifier.h"
+#include "shape.h"
+
+class Set_Expression: public Expression {
+public:
+    const Expression::Ptr object;
+    const Identifier name;
+    const Expression::Ptr value;
+
+    // the shape seen here last and the field's offset in it; set by the Interpreter
+    mutable Property_Cache cache;
+
+    Set_Expression(Expression::Ptr o, const Identifier &n, Expression::Ptr v):
+            object { std::move(o) }, name { n }, value { std::move(v) } { }
+
+    void accept(Expression_Visitor &visitor) const override { visitor.visit(*this); }
+};
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstddef>
+#include <unordered_map>
+#include <utility>
+
+#include "gc.h"
+#include "symbol.h"
+#include "value.h"
+
+// The layout of an instance: which fields it has and at which offset in its
+// field array. Every class starts its instances on a root shape of its own;
+// adding a field moves an instance to the child shape for that name, so
+// instances that got the same fields in the same order share a shape, and a
+// shape implies the class as well. Children are made on demand and live as
+// long as an instance or a cache uses them.
+class Shape final: public Gc_Node {
+        Ref<const Shape> parent_;
+        Symbol name_ = no_symbol;
+        std::unordered_map<Symbol, int> offsets_;
+        // not owned: a child removes itself when it goes
+        mutable std::unordered_map<Symbol, const Shape *> children_;
+
+    public:
+        Shape() = default;
+
+        Shape(Ref<const Shape> parent, Symbol name):
+            parent_ { std::move(parent) }, name_ { name }, offsets_ { parent_->offsets_ }
+        {
+            offsets_.emplace(name, static_cast<int>(offsets_.size()));
+        }
+
+        ~Shape() override {
+            if (parent_) { parent_->children_.erase(name_); }
+        }
+
+        // the offset of a field, < 0 if the shape has none by that name
+        [[nodiscard]] int offset(Symbol name) const {
+            auto got { offsets_.find(name) };
+            return got == offsets_.end() ? -1 : got->second;
+        }
+
+        // the shape of an instance of this one after it gets field name
+        [[nodiscard]] Ref<const Shape> with(Symbol name) const {
+            if (auto got { children_.find(name) }; got != children_.end()) { return Ref<const Shape> { got->second }; }
+            auto child { make_ref<const Shape>(Ref<const Shape> { this }, name) };
+            children_.emplace(name, child.get());
+            return child;
+        }
+
+        [[nodiscard]] std::size_t size() const override {
+            return sizeof(Shape) + (offsets_.size() + children_.size()) * 2 * sizeof(void *);
+        }
+
+        void trace(Gc_Tracer &tracer) const override {
+            if (parent_) { tracer(parent_.get()); }
+        }
+};
+
+// What a property access site saw last: the shape of the instance and the
+// offset of the field there, or the method its class has by that name.
+// A site that sees one shape again skips the lookup. Sites that add a field
+// also keep the shape the instance moves to. The method is not owned: every
+// class has shapes of its own, so an instance of that shape, and with it the
+// class, is alive whenever the method is used. Owning it would keep the
+// method's definition alive from inside itself, in a cycle through the
+// syntax tree that no collection sees.
+struct Property_Cache {
+    Ref<const Shape> shape;
+    int offset = -1;
+    const Value *method = nullptr;
+    Ref<const Shape> next;
+
+    void trace(Gc_Tracer &tracer) const {
+        if (shape) { tracer(shape.get()); }
+        if (next) { tracer(next.get()); }
+    }
+};
@@ -1,6 +1,9 @@
 #pragma once
 
+#include <memory>
+
 class Block_Statement;
+class Class_Statement;
 class Expression_Statement;
 class Function_Definition;
 class If_Statement;
@@ -20,6 +23,7 @@ class Statement_Visitor {
         virtual void visit(const While_Statement &statement) = 0;
         virtual void visit(const Function_Definition &statement) = 0;
         virtual void visit(const Return_Statement &statement) = 0;
+        virtual void visit(const Class_Statement &statement) = 0;
 };
 
 class Statement {
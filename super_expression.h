@@ -0,0 +1,25 @@
+#pragma once
+
+#include "expression.h"
+#include "identifier.h"
+#include "symbol.h"
+#include "this_expression.h"
+#include "token.h"
+#include "var_expression.h"
+
+// `super.method`: the method of the superclass, bound to `this`. The
+// superclass is in a variable the Resolver declares around the methods of
+// a subclass.
+class Super_Expression: public Expression {
+public:
+    const Node_Token keyword;
+    const Identifier method;
+    const Var_Expression superclass;
+    const This_Expression receiver;
+
+    Super_Expression(const Token &k, const Identifier &m):
+            keyword { k }, method { m },
+            superclass { Identifier { Symbol_Table::instance().intern("super"), k.line } }, receiver { k } { }
+
+    void accept(Expression_Visitor &visitor) const override { visitor.visit(*this); }
+};
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "object.h"
+#include "value.h"
+
+using Symbol = std::uint32_t;
+
+// never handed out by the table; marks slots that have no source name
+constexpr Symbol no_symbol { static_cast<Symbol>(-1) };
+
+// Per-thread table of identifier names. Every distinct name is stored once
+// and referred to by its index everywhere else. String constants from the
+// source are interned here as well, so equal constants share one object.
+class Symbol_Table {
+        // open-addressed index into names_; the stored hash saves most string
+        // compares on probes
+        struct Slot {
+            std::uint32_t hash;
+            Symbol symbol;
+        };
+
+        std::deque<std::string> names_;
+        std::vector<Slot> index_ = std::vector<Slot>(1024, Slot { 0, no_symbol });
+        std::vector<Value> strings_;
+
+        Symbol_Table() = default;
+
+        static std::uint32_t hash(std::string_view name) {
+            std::uint32_t result { 2166136261u };
+            for (char ch: name) { result = (result ^ static_cast<unsigned char>(ch)) * 16777619u; }
+            return result;
+        }
+
+        void insert(Slot slot) {
+            std::size_t mask { index_.size() - 1 };
+            std::size_t i { slot.hash & mask };
+            while (index_[i].symbol != no_symbol) { i = (i + 1) & mask; }
+            index_[i] = slot;
+        }
+
+        void grow() {
+            std::vector<Slot> old(index_.size() * 2, Slot { 0, no_symbol });
+            old.swap(index_);
+            for (const Slot &slot: old) {
+                if (slot.symbol != no_symbol) { insert(slot); }
+            }
+        }
+
+    public:
+        // the table of the calling thread, whose strings live on its heap
+        static Symbol_Table &instance() {
+            static thread_local Symbol_Table table;
+            return table;
+        }
+
+        Symbol intern(std::string_view name) {
+            std::uint32_t h { hash(name) };
+            std::size_t mask { index_.size() - 1 };
+            for (std::size_t i { h & mask }; index_[i].symbol != no_symbol; i = (i + 1) & mask) {
+                if (index_[i].hash == h && names_[index_[i].symbol] == name) { return index_[i].symbol; }
+            }
+            Symbol symbol { static_cast<Symbol>(names_.size()) };
+            names_.emplace_back(name);
+            if (names_.size() * 2 > index_.size()) { grow(); }
+            insert(Slot { h, symbol });
+            return symbol;
+        }
+
+        [[nodiscard]] const std::string &name(Symbol symbol) const { return names_[symbol]; }
+
+        Value string_constant(std::string_view text) {
+            Symbol symbol { intern(text) };
+            if (strings_.size() <= symbol) { strings_.resize(symbol + 1); }
+            auto &value { strings_[symbol] };
+            if (value.is_nil()) { value = Value::make<String_Object>(names_[symbol], true); }
+            return value;
+        }
+};
@@ -0,0 +1,21 @@
+# Runs a script twice in one --batch thread and fails unless --gc-stats
+# reports as many collections and pool allocations for both runs. The
+# second run reuses the blocks of the first, so only the counts of what
+# the script does itself match.
+#   cmake -DLOX=<lox binary> -DSCRIPT=<script> -P batch_stats.cmake
+execute_process(COMMAND ${LOX} --batch --jobs=1 --gc-stats ${SCRIPT} ${SCRIPT}
+    RESULT_VARIABLE status OUTPUT_VARIABLE out ERROR_VARIABLE err)
+if(NOT status EQUAL 0)
+    message(FATAL_ERROR "${SCRIPT} failed\n${out}${err}")
+endif()
+string(REGEX MATCHALL "gc: [0-9]+ collections|pool: [0-9]+ allocations" counts "${out}${err}")
+list(LENGTH counts length)
+math(EXPR half "${length} / 2")
+if(half EQUAL 0)
+    message(FATAL_ERROR "no --gc-stats in\n${out}${err}")
+endif()
+list(SUBLIST counts 0 ${half} first)
+list(SUBLIST counts ${half} -1 second)
+if(NOT first STREQUAL second)
+    message(FATAL_ERROR "the second run counts differently\n${first}\n${second}")
+endif()
@@ -0,0 +1,23 @@
+# Runs a script as it is and again with each of the flags in MODES, and
+# fails if a run ends differently or, for a script that runs to its end,
+# prints anything different. --stream runs the statements before an error
+# it has yet to come to, so a failed run only has to report the same. The
+# runs take a copy of the script in the working directory, where --cache
+# keeps its file; --cache twice stores the program and then loads it.
+#   cmake -DLOX=<lox binary> -DSCRIPT=<script> "-DMODES=<flags;...>" -P differential.cmake
+get_filename_component(name ${SCRIPT} NAME)
+configure_file(${SCRIPT} ${CMAKE_CURRENT_BINARY_DIR}/${name} COPYONLY)
+set(SCRIPT ${CMAKE_CURRENT_BINARY_DIR}/${name})
+file(REMOVE ${SCRIPT}c)
+execute_process(COMMAND ${LOX} ${SCRIPT}
+    RESULT_VARIABLE expected_status OUTPUT_VARIABLE expected_out ERROR_VARIABLE expected_err)
+foreach(mode IN LISTS MODES)
+    separate_arguments(flags UNIX_COMMAND "${mode}")
+    execute_process(COMMAND ${LOX} ${flags} ${SCRIPT} RESULT_VARIABLE status OUTPUT_VARIABLE out ERROR_VARIABLE err)
+    message(STATUS "${mode}\n${out}${err}")
+    if(NOT status STREQUAL expected_status OR NOT err STREQUAL expected_err
+            OR (expected_status EQUAL 0 AND NOT out STREQUAL expected_out))
+        message(FATAL_ERROR "${mode} differs for ${SCRIPT}\n-- as it is (${expected_status})\n${expected_out}${expected_err}"
+            "\n-- ${mode} (${status})\n${out}${err}")
+    endif()
+endforeach()
@@ -0,0 +1,15 @@
+# Runs a script with the given flags and fails if more heap objects were
+# alive at once than the limit allows.
+#   cmake -DLOX=<lox binary> -DSCRIPT=<script> -DFLAGS=<flags> -DLIMIT=<objects> -P peak_objects.cmake
+separate_arguments(flags UNIX_COMMAND "${FLAGS}")
+execute_process(COMMAND ${LOX} ${flags} --stats=json ${SCRIPT}
+    RESULT_VARIABLE status OUTPUT_QUIET ERROR_VARIABLE stats)
+if(NOT status EQUAL 0)
+    message(FATAL_ERROR "${SCRIPT} failed\n${stats}")
+endif()
+if(NOT stats MATCHES "\"peak_objects\": ([0-9]+)")
+    message(FATAL_ERROR "no peak_objects in\n${stats}")
+endif()
+if(CMAKE_MATCH_1 GREATER LIMIT)
+    message(FATAL_ERROR "${SCRIPT} ${FLAGS}: ${CMAKE_MATCH_1} objects alive at once, limit ${LIMIT}")
+endif()
@@ -0,0 +1,18 @@
+# Runs a script under --profile and fails unless the report has a row for
+# each of the labels, and no others.
+#   cmake -DLOX=<lox binary> -DSCRIPT=<script> -DFLAGS=<flags> -DLABELS=<label;...> -P profile_labels.cmake
+separate_arguments(flags UNIX_COMMAND "${FLAGS}")
+execute_process(COMMAND ${LOX} ${flags} --profile ${SCRIPT}
+    RESULT_VARIABLE status OUTPUT_QUIET ERROR_VARIABLE report)
+if(NOT status EQUAL 0)
+    message(FATAL_ERROR "${SCRIPT} failed\n${report}")
+endif()
+string(REGEX MATCHALL "  [^ \n]+\n" rows "${report}")
+list(TRANSFORM rows STRIP)
+list(REMOVE_ITEM rows function)
+list(SORT rows)
+set(expected ${LABELS})
+list(SORT expected)
+if(NOT rows STREQUAL expected)
+    message(FATAL_ERROR "${SCRIPT} ${FLAGS}: rows ${rows}, expected ${expected}\n${report}")
+endif()
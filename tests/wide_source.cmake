@@ -0,0 +1,23 @@
+# Writes a flat script with more globals, constants and property names than
+# 16-bit indices reach, for the Vm's WIDE ops.
+#   cmake -DSCRIPT=<script to write> -P wide_source.cmake
+set(source "class A { init() { this.x = 1; } m() { return 1; } }\nvar a = A();\nvar t = 0;\n")
+# a thousand lines at a time, as appending to one long string is slow
+foreach(block RANGE 69)
+    set(lines "")
+    foreach(line RANGE 999)
+        math(EXPR i "${block} * 1000 + ${line}")
+        string(APPEND lines "var g${i} = ${i};\n")
+    endforeach()
+    string(APPEND source "${lines}")
+endforeach()
+set(lines "")
+foreach(line RANGE 999)
+    string(APPEND lines "t = t + a.x + a.m();\n")
+endforeach()
+string(REPEAT "${lines}" 35 lines)
+string(APPEND source "${lines}")
+string(APPEND source "class B < A { m() { return super.m() + 1; } n() { return this.m(); } }\n"
+    "g0 = \"first\";\n"
+    "print g0;\nprint g65536;\nprint g69999;\nprint t;\nprint B().n();\n")
+file(WRITE ${SCRIPT} "${source}")
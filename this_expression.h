@@ -0,0 +1,17 @@
+#pragma once
+
+#include "expression.h"
+#include "identifier.h"
+#include "symbol.h"
+#include "token.h"
+#include "var_expression.h"
+
+// `this` in a method: a read of the variable the Resolver declares in slot 0
+// of every method, so the engines treat it like any other variable.
+class This_Expression: public Var_Expression {
+public:
+    explicit This_Expression(const Token &keyword):
+            Var_Expression { Identifier { Symbol_Table::instance().intern("this"), keyword.line } } { }
+
+    void accept(Expression_Visitor &visitor) const override { visitor.visit(*this); }
+};
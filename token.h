@@ -1,10 +1,10 @@
 #pragma once
 
+#include <cstdint>
 #include <string>
-#include <memory>
-#include <utility>
+#include <string_view>
 
-#include "literal.h"
+#include "symbol.h"
 
 enum class Token_Type {
     LEFT_PAREN, RIGHT_PAREN, LEFT_BRACE, RIGHT_BRACE,
@@ -66,35 +66,35 @@ inline std::string to_string(const Token_Type &type) {
     }
 }
 
+// A token is a slice of the source buffer plus its type. Lexemes and literal
+// values are read back from the source on demand, so scanning allocates
+// nothing per token beyond the stream itself.
 class Token {
     public:
         const Token_Type type;
-        const std::string lexeme;
-        const Literal::Ptr literal;
+        const std::uint32_t offset;
+        const std::uint32_t length;
         const int line;
+        const Symbol symbol = no_symbol;
 
-        Token(Token_Type type, std::string lexeme, int line):
-            type { type }, lexeme { std::move(lexeme) }, literal { }, line { line }
+        Token(Token_Type type, std::uint32_t offset, std::uint32_t length, int line):
+            type { type }, offset { offset }, length { length }, line { line }
         { }
 
-        Token(Token_Type type, std::string lexeme, bool literal, int line):
-            type { type }, lexeme { std::move(lexeme) },
-            literal { Literal::create(literal) }, line { line }
+        Token(Token_Type type, std::uint32_t offset, std::uint32_t length, Symbol symbol, int line):
+            type { type }, offset { offset }, length { length }, line { line }, symbol { symbol }
         { }
 
-        Token(Token_Type type, std::string lexeme, std::string literal, int line):
-            type { type }, lexeme { std::move(lexeme) },
-            literal { Literal::create(std::move(literal)) }, line { line }
-        { }
-
-        Token(Token_Type type, std::string lexeme, double literal, int line):
-            type { type }, lexeme { std::move(lexeme) },
-            literal { Literal::create(literal) }, line { line }
-        { }
+        [[nodiscard]] std::string_view lexeme(std::string_view source) const {
+            return source.substr(offset, length);
+        }
+};
 
-        Token(const Token &token) = default;
+// The part of an operator or keyword token that AST nodes keep.
+class Node_Token {
+    public:
+        Token_Type type;
+        int line;
 
-        explicit operator std::string() const {
-            return to_string(type) + " " + lexeme + " " + Literal::to_string(literal);
-        }
+        Node_Token(const Token &token): type { token.type }, line { token.line } { }
 };
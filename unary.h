@@ -5,10 +5,10 @@
 
 class Unary: public Expression {
     public:
-        const Token token;
+        const Node_Token token;
         Expression::Ptr right;
 
-        Unary(const Token &t, Expression::Ptr r): token {t }, right {std::move(r) } { }
+        Unary(const Node_Token &t, Expression::Ptr r): token {t }, right {std::move(r) } { }
 
         void accept(Expression_Visitor &visitor) const override { visitor.visit(*this); }
 };
\ No newline at end of file
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <utility>
+
+#include "object.h"
+
+// A runtime value packed into 64 bits. Numbers are stored as plain doubles;
+// everything else hides in the payload of a quiet NaN: nil and the booleans
+// as small tags, heap objects as a pointer with the sign bit set.
+class Value {
+        static constexpr std::uint64_t sign_bit { 0x8000000000000000 };
+        static constexpr std::uint64_t quiet_nan { 0x7ffc000000000000 };
+        static constexpr std::uint64_t nil_tag { 1 };
+        static constexpr std::uint64_t false_tag { 2 };
+        static constexpr std::uint64_t true_tag { 3 };
+        static constexpr std::uint64_t nil_bits { quiet_nan | nil_tag };
+
+        std::uint64_t bits_;
+
+        friend class Jit_Compiler;
+
+        void retain() const { if (is_object()) { ++as_object()->refs_; } }
+        void release() const {
+            if (is_object()) {
+                const Object *object { as_object() };
+                if (--object->refs_ == 0) { delete object; }
+            }
+        }
+
+    public:
+        Value(): bits_ { nil_bits } { }
+        explicit Value(bool value): bits_ { quiet_nan | (value ? true_tag : false_tag) } { }
+        explicit Value(double value) { std::memcpy(&bits_, &value, sizeof(double)); }
+        explicit Value(const Object *object):
+            bits_ { sign_bit | quiet_nan | reinterpret_cast<std::uintptr_t>(object) }
+        { retain(); }
+
+        Value(const Value &other): bits_ { other.bits_ } { retain(); }
+        Value(Value &&other) noexcept: bits_ { other.bits_ } { other.bits_ = nil_bits; }
+        Value &operator=(Value other) noexcept { std::swap(bits_, other.bits_); return *this; }
+        ~Value() { release(); }
+
+        // a new reference to the value these bits encode, for code that
+        // passes values around as raw bits
+        static Value from_bits(std::uint64_t bits) {
+            Value value;
+            value.bits_ = bits;
+            value.retain();
+            return value;
+        }
+
+        template<typename T, typename... Args> static Value make(Args &&... args) {
+            Value value { static_cast<const Object *>(new T(std::forward<Args>(args)...)) };
+            Heap::instance().allocated(value.as_object());
+            return value;
+        }
+
+        [[nodiscard]] std::uint64_t bits() const { return bits_; }
+
+        [[nodiscard]] bool is_nil() const { return bits_ == nil_bits; }
+        [[nodiscard]] bool is_bool() const { return (bits_ | 1) == (quiet_nan | true_tag); }
+        [[nodiscard]] bool is_number() const { return (bits_ & quiet_nan) != quiet_nan; }
+        [[nodiscard]] bool is_object() const { return (bits_ & (sign_bit | quiet_nan)) == (sign_bit | quiet_nan); }
+        [[nodiscard]] bool is_object(Object_Type type) const { return is_object() && as_object()->type == type; }
+        [[nodiscard]] bool is_string() const { return is_object(Object_Type::STRING); }
+
+        [[nodiscard]] bool as_bool() const { return bits_ == (quiet_nan | true_tag); }
+        [[nodiscard]] double as_number() const {
+            double value;
+            std::memcpy(&value, &bits_, sizeof(double));
+            return value;
+        }
+        [[nodiscard]] const Object *as_object() const {
+            return reinterpret_cast<const Object *>(static_cast<std::uintptr_t>(bits_ & ~(sign_bit | quiet_nan)));
+        }
+        template<typename T> [[nodiscard]] const T &as() const { return static_cast<const T &>(*as_object()); }
+        [[nodiscard]] const std::string &as_string() const { return as<String_Object>().value; }
+
+        void trace(Gc_Tracer &tracer) const { if (is_object()) { tracer(as_object()); } }
+
+        [[nodiscard]] bool is_truthy() const {
+            if (is_nil()) { return false; }
+            if (is_bool()) { return as_bool(); }
+            return true;
+        }
+
+        [[nodiscard]] bool operator==(const Value &other) const {
+            if (is_number() && other.is_number()) { return as_number() == other.as_number(); }
+            if (bits_ == other.bits_) { return true; }
+            if (is_string() && other.is_string()) {
+                const auto &a { as<String_Object>() };
+                const auto &b { other.as<String_Object>() };
+                return ! (a.interned && b.interned) && a.value == b.value;
+            }
+            return false;
+        }
+
+        [[nodiscard]] std::string to_string() const {
+            if (is_nil()) { return "nil"; }
+            if (is_bool()) { return as_bool() ? "true" : "false"; }
+            if (is_number()) { return std::to_string(as_number()); }
+            return static_cast<std::string>(*as_object());
+        }
+};
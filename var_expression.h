@@ -1,12 +1,25 @@
 #pragma once
 
-#include "token.h"
+#include "expression.h"
+#include "identifier.h"
 
 class Var_Expression: public Expression {
 public:
-    const Token name;
+    const Identifier name;
 
-    explicit Var_Expression(const Token &n): name { n } { }
+    // filled in by the Resolver: environment hops and slot, depth < 0 for globals
+    mutable int depth = -1;
+    mutable int slot = -1;
+    // the slot holds the Cell of a variable closures capture
+    mutable bool boxed = false;
+    // index into the closure's cells for a variable of an enclosing
+    // function, with depth < 0
+    mutable int upvalue = -1;
+
+    // slot in the Interpreter's global table, looked up on the first read
+    mutable int global = -1;
+
+    explicit Var_Expression(const Identifier &n): name { n } { }
 
     void accept(Expression_Visitor &visitor) const override { visitor.visit(*this); }
 };
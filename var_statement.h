@@ -5,14 +5,19 @@
 #include <memory>
 
 #include "expression.h"
-#include "token.h"
+#include "identifier.h"
 
 class Var_Statement: public Statement {
 public:
-    const Token name;
+    const Identifier name;
     const Expression::Ptr initializer;
 
-    explicit Var_Statement(const Token &n, Expression::Ptr i): name {n }, initializer {std::move(i) } { }
+    // slot in the current environment, < 0 for globals; set by the Resolver
+    mutable int slot = -1;
+    // a nested function captures the variable, so it is declared in a Cell
+    mutable bool captured = false;
+
+    explicit Var_Statement(const Identifier &n, Expression::Ptr i): name {n }, initializer {std::move(i) } { }
 
     void accept(Statement_Visitor &visitor) const override { visitor.visit(*this); }
 };
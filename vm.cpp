@@ -0,0 +1,483 @@
+#include "vm.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "cell.h"
+#include "compiler.h"
+#include "err.h"
+#include "lox_class.h"
+#include "profiler.h"
+
+Vm::Vm(Reporter &reporter, std::ostream &out): host_ { reporter, out } {
+    // natives live in the tree-walker's globals, so both engines see the same set
+    globals_ = host_.globals;
+}
+
+int Vm::current_line() const {
+    if (frames_.empty()) { return 0; }
+    const auto &frame { frames_.back() };
+    const auto &chunk { frame.function->chunk };
+    auto offset { frame.ip - chunk.code.data() - 1 };
+    return offset >= 0 ? chunk.lines[offset] : 0;
+}
+
+// the Lox function a callee runs, null if it is not one
+static const Compiled_Function *compiled(const Value &callee, const std::vector<Value> *&cells) {
+    if (callee.is_object(Object_Type::COMPILED_FUNCTION)) {
+        cells = nullptr;
+        return &callee.as<Compiled_Function>();
+    }
+    if (callee.is_object(Object_Type::CLOSURE)) {
+        const auto &closure { callee.as<Closure>() };
+        cells = &closure.cells;
+        return &closure.function.as<Compiled_Function>();
+    }
+    return nullptr;
+}
+
+void Vm::call_value(const Value &callee, int count) {
+    const std::vector<Value> *cells;
+    if (const auto *fn { compiled(callee, cells) }) {
+        if (count != fn->arity) {
+            throw Exception("Expected " + std::to_string(fn->arity) + " arguments, but got " + std::to_string(count) + ".");
+        }
+        if (frames_.size() >= max_frames) { throw Exception("Stack overflow."); }
+        if (Profiler::enabled) { Profiler::instance().enter(fn, [fn] { return Profiler::Label { fn->label, fn->line }; }); }
+        frames_.push_back({ fn, fn->chunk.code.data(), stack_.size() - count - 1, cells });
+        ++stats.calls;
+        stats.peak_depth = std::max(stats.peak_depth, frames_.size() - 1);
+        return;
+    }
+    if (callee.is_object(Object_Type::CALLABLE)) {
+        call_callable(callee, count);
+        return;
+    }
+    throw Exception("Can only call functions and classes.");
+}
+
+// Classes and bound methods call Lox functions, so the VM calls them itself,
+// with the instance in the callee's slot. Kept apart from call_value so
+// that calls to Lox functions stay short.
+void Vm::call_callable(const Value &callee, int count) {
+    std::size_t slot { stack_.size() - count - 1 };
+    if (const auto *klass { dynamic_cast<const Lox_Class *>(callee.as_object()) }) {
+        // the instance keeps the class alive once it replaces it
+        stack_[slot] = Value::make<Instance>(Value { callee });
+        if (! klass->init.is_nil()) {
+            call_value(klass->init, count);
+        } else if (count != 0) {
+            throw Exception("Expected 0 arguments, but got " + std::to_string(count) + ".");
+        }
+        return;
+    }
+    if (const auto *bound { dynamic_cast<const Bound_Method *>(callee.as_object()) }) {
+        Value method { bound->method };
+        stack_[slot] = Value { bound->receiver };
+        call_value(method, count);
+        return;
+    }
+    const auto *fn { &callee.as<Callable_Literal>() };
+    if (count != fn->arity()) {
+        throw Exception("Expected " + std::to_string(fn->arity()) + " arguments, but got " + std::to_string(count) + ".");
+    }
+    // natives run no Lox code, so the stack stays where it is
+    auto result { fn->call(host_, std::span<const Value> { stack_.data() + slot + 1, static_cast<std::size_t>(count) }) };
+    std::string message;
+    if (host_.take_error(message)) { throw Exception(message); }
+    stack_.resize(slot);
+    stack_.push_back(std::move(result));
+}
+
+// the instance whose properties an op looks up
+static const Instance &instance(const Value &object, const char *message) {
+    if (! object.is_object(Object_Type::INSTANCE)) { throw Vm::Exception(message); }
+    return object.as<Instance>();
+}
+
+static Vm::Exception undefined(Symbol name) {
+    return Vm::Exception("Undefined property '" + Symbol_Table::instance().name(name) + "'.");
+}
+
+// Makes the class name of the methods on top of the stack and, under them,
+// the superclass if it has one.
+void Vm::make_class(const Chunk &chunk, Symbol name, const std::uint8_t *&ip) {
+    auto read_long { [&]() {
+        ip += 3;
+        return static_cast<int>((ip[-3] << 16) | (ip[-2] << 8) | ip[-1]);
+    } };
+    bool inherits { *ip++ != 0 };
+    int count { *ip++ };
+    std::size_t first { stack_.size() - count };
+    Lox_Class::Methods methods;
+    for (std::size_t i = first; i < stack_.size(); ++i) {
+        methods.insert_or_assign(chunk.names[read_long()], std::move(stack_[i]));
+    }
+    stack_.resize(first);
+    Value superclass;
+    if (inherits) {
+        superclass = std::move(stack_.back());
+        stack_.pop_back();
+        if (! Lox_Class::is_class(superclass)) { throw Exception("Superclass must be a class."); }
+    }
+    stack_.push_back(Value::make<Lox_Class>(
+        Symbol_Table::instance().name(name), std::move(superclass), std::move(methods), make_ref<const Shape>()
+    ));
+}
+
+void Vm::get_property(const Chunk &chunk, int site) {
+    Value object { std::move(stack_.back()) };
+    stack_.pop_back();
+    bool method;
+    const Value *property {
+        instance(object, "Only instances have properties.").get(chunk.names[site], chunk.caches[site], method)
+    };
+    if (! property) { throw undefined(chunk.names[site]); }
+    stack_.push_back(method ? Value::make<Bound_Method>(std::move(object), *property) : *property);
+}
+
+void Vm::set_property(const Chunk &chunk, int site) {
+    Value value { std::move(stack_.back()) };
+    stack_.pop_back();
+    const Value &object { stack_.back() };
+    instance(object, "Only instances have fields.").set(chunk.names[site], value, chunk.caches[site]);
+    stack_.back() = std::move(value);
+}
+
+// What calling a property of the instance in the callee's slot calls: a
+// method, which expects this where the instance is, so it needs no binding,
+// or a field, which takes the instance's place as any callee would.
+const Value &Vm::invoked(const Chunk &chunk, int site, int count) {
+    std::size_t slot { stack_.size() - count - 1 };
+    bool method;
+    const Value *property {
+        instance(stack_[slot], "Only instances have properties.").get(chunk.names[site], chunk.caches[site], method)
+    };
+    if (! property) { throw undefined(chunk.names[site]); }
+    if (method) { return *property; }
+    Value field { *property };
+    stack_[slot] = std::move(field);
+    return stack_[slot];
+}
+
+void Vm::get_super(Symbol name) {
+    Value superclass { std::move(stack_.back()) };
+    stack_.pop_back();
+    const Value *method { superclass.as<Lox_Class>().find(name) };
+    if (! method) { throw undefined(name); }
+    stack_.back() = Value::make<Bound_Method>(std::move(stack_.back()), *method);
+}
+
+// the superclass's method a super call calls, with the superclass taken
+// off the stack
+Value Vm::super_method(Symbol name) {
+    Value superclass { std::move(stack_.back()) };
+    stack_.pop_back();
+    const Value *method { superclass.as<Lox_Class>().find(name) };
+    if (! method) { throw undefined(name); }
+    return *method;
+}
+
+// Calls function with the arguments on top of the stack and the callee's
+// slot under them. A Lox function takes over the frame of the one
+// returning; anything else is a plain call and the RETURN after it returns
+// its result.
+void Vm::tail_call(Value function, int count) {
+    std::size_t callee { stack_.size() - count - 1 };
+    const std::vector<Value> *cells;
+    const auto *fn { compiled(function, cells) };
+    if (! fn) {
+        call_value(function, count);
+        return;
+    }
+    if (count != fn->arity) {
+        throw Exception("Expected " + std::to_string(fn->arity) + " arguments, but got " + std::to_string(count) + ".");
+    }
+    std::size_t base { frames_.back().base };
+    std::move(stack_.begin() + callee, stack_.end(), stack_.begin() + base);
+    stack_.resize(base + count + 1);
+    frames_.pop_back();
+    if (Profiler::enabled) { Profiler::instance().leave(); }
+    call_value(function, count);
+}
+
+void Vm::run() {
+    Call_Frame *frame { &frames_.back() };
+
+    auto read_byte { [&]() { return *frame->ip++; } };
+    auto read_short { [&]() {
+        frame->ip += 2;
+        return static_cast<int>((frame->ip[-2] << 8) | frame->ip[-1]);
+    } };
+    // the high byte a WIDE before the op gave its index
+    int wide { 0 };
+    auto read_index { [&]() { return std::exchange(wide, 0) | read_short(); } };
+    auto pop { [&]() {
+        Value value { std::move(stack_.back()) };
+        stack_.pop_back();
+        return value;
+    } };
+    auto numbers { [&](const char *message) {
+        const auto &a { stack_[stack_.size() - 2] };
+        const auto &b { stack_.back() };
+        if (! a.is_number() || ! b.is_number()) { throw Exception(message); }
+    } };
+
+    for (;;) {
+        switch (static_cast<Op_Code>(read_byte())) {
+            case Op_Code::WIDE:
+                wide = read_byte() << 16;
+                break;
+            case Op_Code::CONSTANT:
+                stack_.push_back(frame->function->chunk.constants[read_index()]);
+                break;
+            case Op_Code::NIL: stack_.emplace_back(); break;
+            case Op_Code::TRUE: stack_.push_back(Value { true }); break;
+            case Op_Code::FALSE: stack_.push_back(Value { false }); break;
+            case Op_Code::POP: stack_.pop_back(); break;
+            case Op_Code::POP_N: stack_.resize(stack_.size() - read_byte()); break;
+            case Op_Code::GET_LOCAL:
+                stack_.push_back(stack_[frame->base + read_byte()]);
+                break;
+            case Op_Code::SET_LOCAL:
+                stack_[frame->base + read_byte()] = stack_.back();
+                break;
+            case Op_Code::GET_GLOBAL: {
+                int slot { read_index() };
+                if (! globals_.defined[slot]) {
+                    throw Exception("Undefined variable '" + Symbol_Table::instance().name(globals_.names[slot]) + "'.");
+                }
+                stack_.push_back(globals_.values[slot]);
+                break;
+            }
+            case Op_Code::DEFINE_GLOBAL: {
+                int slot { read_index() };
+                globals_.set(slot, pop());
+                break;
+            }
+            case Op_Code::SET_GLOBAL: {
+                int slot { read_index() };
+                if (! globals_.defined[slot]) {
+                    throw Exception("Undefined variable '" + Symbol_Table::instance().name(globals_.names[slot]) + "'.");
+                }
+                globals_.set(slot, stack_.back());
+                break;
+            }
+            case Op_Code::BOX: {
+                Value &local { stack_[frame->base + read_byte()] };
+                Value value { std::move(local) };
+                local = Value::make<Cell>(std::move(value));
+                break;
+            }
+            case Op_Code::GET_CELL:
+                stack_.push_back(stack_[frame->base + read_byte()].as<Cell>().value);
+                break;
+            case Op_Code::SET_CELL:
+                stack_[frame->base + read_byte()].as<Cell>().value = stack_.back();
+                break;
+            case Op_Code::GET_UPVALUE:
+                stack_.push_back((*frame->cells)[read_byte()].as<Cell>().value);
+                break;
+            case Op_Code::SET_UPVALUE:
+                (*frame->cells)[read_byte()].as<Cell>().value = stack_.back();
+                break;
+            case Op_Code::CLOSURE: {
+                const Value &function { frame->function->chunk.constants[read_index()] };
+                int count { read_byte() };
+                std::vector<Value> cells;
+                cells.reserve(count);
+                for (int i = 0; i < count; ++i) {
+                    bool local { read_byte() != 0 };
+                    int index { read_byte() };
+                    cells.push_back(local ? stack_[frame->base + index] : (*frame->cells)[index]);
+                }
+                stack_.push_back(Value::make<Closure>(function, std::move(cells)));
+                break;
+            }
+            case Op_Code::EQUAL: {
+                auto b { pop() };
+                auto a { pop() };
+                stack_.push_back(Value { a == b });
+                break;
+            }
+            case Op_Code::NOT_EQUAL: {
+                auto b { pop() };
+                auto a { pop() };
+                stack_.push_back(Value { a != b });
+                break;
+            }
+            case Op_Code::GREATER: {
+                numbers("Operands must be numbers.");
+                double b { pop().as_number() };
+                double a { pop().as_number() };
+                stack_.emplace_back(a > b);
+                break;
+            }
+            case Op_Code::GREATER_EQUAL: {
+                numbers("Operands must be numbers.");
+                double b { pop().as_number() };
+                double a { pop().as_number() };
+                stack_.emplace_back(a >= b);
+                break;
+            }
+            case Op_Code::LESS: {
+                numbers("Operands must be numbers.");
+                double b { pop().as_number() };
+                double a { pop().as_number() };
+                stack_.emplace_back(a < b);
+                break;
+            }
+            case Op_Code::LESS_EQUAL: {
+                numbers("Operands must be numbers.");
+                double b { pop().as_number() };
+                double a { pop().as_number() };
+                stack_.emplace_back(a <= b);
+                break;
+            }
+            case Op_Code::ADD: {
+                auto b { pop() };
+                auto a { pop() };
+                if (a.is_number() && b.is_number()) {
+                    stack_.emplace_back(a.as_number() + b.as_number());
+                } else if (a.is_string() && b.is_string()) {
+                    stack_.push_back(Value::make<String_Object>(a.as_string() + b.as_string()));
+                } else {
+                    throw Exception("Operands must be two numbers or two strings.");
+                }
+                break;
+            }
+            case Op_Code::SUBTRACT: {
+                numbers("Operands must be numbers.");
+                double b { pop().as_number() };
+                double a { pop().as_number() };
+                stack_.emplace_back(a - b);
+                break;
+            }
+            case Op_Code::MULTIPLY: {
+                numbers("Operands must be numbers.");
+                double b { pop().as_number() };
+                double a { pop().as_number() };
+                stack_.emplace_back(a * b);
+                break;
+            }
+            case Op_Code::DIVIDE: {
+                numbers("Operands must be numbers.");
+                double b { pop().as_number() };
+                double a { pop().as_number() };
+                stack_.emplace_back(a / b);
+                break;
+            }
+            case Op_Code::NOT:
+                stack_.back() = Value { ! stack_.back().is_truthy() };
+                break;
+            case Op_Code::NEGATE: {
+                const auto &value { stack_.back() };
+                if (! value.is_number()) { throw Exception("Operand must be a number."); }
+                stack_.back() = Value { -value.as_number() };
+                break;
+            }
+            case Op_Code::PRINT:
+                host_.out() << pop().to_string() << "\n";
+                break;
+            case Op_Code::JUMP: {
+                int offset { read_short() };
+                frame->ip += offset;
+                break;
+            }
+            case Op_Code::JUMP_IF_FALSE: {
+                int offset { read_short() };
+                if (! stack_.back().is_truthy()) { frame->ip += offset; }
+                break;
+            }
+            case Op_Code::LOOP: {
+                int offset { read_short() };
+                frame->ip -= offset;
+                break;
+            }
+            case Op_Code::CALL: {
+                int count { read_byte() };
+                call_value(stack_[stack_.size() - count - 1], count);
+                frame = &frames_.back();
+                break;
+            }
+            case Op_Code::TAIL_CALL: {
+                int count { read_byte() };
+                tail_call(stack_[stack_.size() - count - 1], count);
+                frame = &frames_.back();
+                break;
+            }
+            case Op_Code::CLASS: {
+                Symbol name { frame->function->chunk.names[read_index()] };
+                make_class(frame->function->chunk, name, frame->ip);
+                break;
+            }
+            case Op_Code::GET_PROPERTY:
+                get_property(frame->function->chunk, read_index());
+                break;
+            case Op_Code::SET_PROPERTY:
+                set_property(frame->function->chunk, read_index());
+                break;
+            case Op_Code::INVOKE: {
+                int site { read_index() };
+                int count { read_byte() };
+                call_value(invoked(frame->function->chunk, site, count), count);
+                frame = &frames_.back();
+                break;
+            }
+            case Op_Code::TAIL_INVOKE: {
+                int site { read_index() };
+                int count { read_byte() };
+                tail_call(invoked(frame->function->chunk, site, count), count);
+                frame = &frames_.back();
+                break;
+            }
+            case Op_Code::GET_SUPER:
+                get_super(frame->function->chunk.names[read_index()]);
+                break;
+            case Op_Code::SUPER_INVOKE: {
+                Symbol name { frame->function->chunk.names[read_index()] };
+                int count { read_byte() };
+                call_value(super_method(name), count);
+                frame = &frames_.back();
+                break;
+            }
+            case Op_Code::TAIL_SUPER_INVOKE: {
+                Symbol name { frame->function->chunk.names[read_index()] };
+                int count { read_byte() };
+                tail_call(super_method(name), count);
+                frame = &frames_.back();
+                break;
+            }
+            case Op_Code::RETURN: {
+                auto result { pop() };
+                stack_.resize(frame->base);
+                frames_.pop_back();
+                if (frames_.empty()) { return; }
+                if (Profiler::enabled) { Profiler::instance().leave(); }
+                stack_.push_back(std::move(result));
+                frame = &frames_.back();
+                break;
+            }
+        }
+    }
+}
+
+void Vm::interpret(const std::vector<Statement::Ptr> &statements) {
+    Compiler compiler { globals_, host_.reporter() };
+    auto script { compiler.compile(statements) };
+    if (script.is_nil()) { return; }
+    stack_.clear();
+    frames_.clear();
+    stack_.push_back(script);
+    const auto *function { &script.as<Compiled_Function>() };
+    frames_.push_back({ function, function->chunk.code.data(), 0, nullptr });
+    std::size_t depth { Profiler::instance().depth() };
+    try {
+        run();
+    } catch (const Exception &ex) {
+        Profiler::instance().unwind(depth);
+        host_.reporter().runtime_error(current_line(), ex.what());
+        stack_.clear();
+        frames_.clear();
+    }
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "chunk.h"
+#include "global_table.h"
+#include "interpreter.h"
+#include "statement.h"
+#include "value.h"
+
+class Vm {
+        struct Call_Frame {
+            const Compiled_Function *function;
+            const std::uint8_t *ip;
+            std::size_t base;
+            // the cells of the closure, null for a function without any
+            const std::vector<Value> *cells;
+        };
+
+        static constexpr std::size_t max_frames { 64 * 1024 };
+
+        Interpreter host_;
+        Global_Table globals_;
+        std::vector<Value> stack_;
+        std::vector<Call_Frame> frames_;
+
+        void run();
+        void call_value(const Value &callee, int count);
+        void call_callable(const Value &callee, int count);
+        // the ops on classes and instances, kept out of run so that they
+        // leave the other ops' code as it was
+        void make_class(const Chunk &chunk, Symbol name, const std::uint8_t *&ip);
+        void get_property(const Chunk &chunk, int site);
+        void set_property(const Chunk &chunk, int site);
+        const Value &invoked(const Chunk &chunk, int site, int count);
+        void get_super(Symbol name);
+        Value super_method(Symbol name);
+        void tail_call(Value function, int count);
+        [[nodiscard]] int current_line() const;
+
+    public:
+        class Exception: public std::domain_error {
+            public:
+                Exception(const std::string &m): std::domain_error { m } { }
+        };
+
+        // Lox function calls and the deepest they nested, not counting the
+        // script itself
+        struct Stats {
+            std::size_t calls = 0;
+            std::size_t peak_depth = 0;
+        };
+
+        Stats stats;
+
+        // the VM prints to out and reports errors to reporter
+        Vm(Reporter &reporter, std::ostream &out);
+
+        void interpret(const std::vector<Statement::Ptr> &statements);
+};